@@ -0,0 +1,160 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/*
+ * Generator on top of C++20 coroutines, with the same range-for surface as Generator
+ * but without a thread: the body is a coroutine that co_yields its values, and it runs
+ * on the consumer's thread whenever the iterator is advanced.
+ *
+ *     auto count(int n) -> CoroutineGenerator<int> {
+ *         for (int i = 0; i < n; ++i) {
+ *             co_yield i;
+ *         }
+ *     }
+ *
+ * A yielded value isn't copied or moved: the iterator points at it while the body is
+ * suspended. The only allocation is the coroutine frame, once per generator. Unlike
+ * Generator, an exception thrown by the body is rethrown to the consumer.
+ *
+ * The body runs after its call returns, so it should take its parameters by value: a
+ * reference parameter bound to a temporary dangles by the time the body reads it.
+ */
+template <typename T>
+class CoroutineGenerator {
+public:
+    struct promise_type {
+        auto get_return_object() noexcept -> CoroutineGenerator {
+            return CoroutineGenerator { std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+
+        // the body doesn't start until begin()
+        auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+        auto final_suspend() noexcept -> std::suspend_always { return {}; }
+
+        /*
+         * A temporary in the co_yield expression lives until the body is resumed, so
+         * pointing at it is safe
+         */
+        auto yield_value(const T& value) noexcept -> std::suspend_always {
+            _value = std::addressof(value);
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept { _exception = std::current_exception(); }
+
+        // only co_yield makes sense in a generator
+        template <typename U>
+        auto await_transform(U&&) -> std::suspend_never = delete;
+
+    private:
+        const T* _value { nullptr };
+        std::exception_ptr _exception;
+
+        friend class CoroutineGenerator;
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class GeneratorIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = T;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        GeneratorIterator() = default;
+
+        auto operator*() const -> reference { return *_coroutine.promise()._value; }
+        auto operator->() const -> pointer { return _coroutine.promise()._value; }
+
+        auto operator++() -> GeneratorIterator& {
+            resume(_coroutine);
+            return *this;
+        }
+
+        auto operator++(int) -> void { ++(*this); }
+
+        // all iterators that reached the end are equal, like the end() iterator
+        friend auto operator==(const GeneratorIterator& a, const GeneratorIterator& b) -> bool {
+            return a.done() == b.done();
+        }
+
+    private:
+        Handle _coroutine;
+
+        explicit GeneratorIterator(Handle coroutine) noexcept
+            : _coroutine { coroutine } {}
+
+        [[nodiscard]] auto done() const noexcept -> bool { return !_coroutine || _coroutine.done(); }
+
+        friend class CoroutineGenerator;
+    };
+
+    CoroutineGenerator(CoroutineGenerator&& other) noexcept
+        : _coroutine { std::exchange(other._coroutine, nullptr) }
+        , _started { other._started } {}
+
+    auto operator=(CoroutineGenerator&& other) noexcept -> CoroutineGenerator& {
+        CoroutineGenerator moved { std::move(other) };
+        std::swap(_coroutine, moved._coroutine);
+        std::swap(_started, moved._started);
+        return *this;
+    }
+
+    CoroutineGenerator(const CoroutineGenerator&) = delete;
+    auto operator=(const CoroutineGenerator&) -> CoroutineGenerator& = delete;
+
+    /*
+     * Destroying a generator that hasn't finished destroys the suspended body, running
+     * the destructors of its locals
+     */
+    ~CoroutineGenerator() {
+        if (_coroutine) {
+            _coroutine.destroy();
+        }
+    }
+
+    /*
+     * Get the iterator to the first element in the generator.
+     * May only be called once on the existing generator, otherwise
+     * an exception will be raised.
+     */
+    auto begin() -> GeneratorIterator {
+        if (_started) {
+            throw std::runtime_error("Generator is already being consumed");
+        }
+        _started = true;
+        resume(_coroutine);
+        return GeneratorIterator { _coroutine };
+    }
+
+    /*
+     * Iterator to indicate the end of the generation stream
+     */
+    auto end() noexcept -> GeneratorIterator { return GeneratorIterator {}; }
+
+private:
+    Handle _coroutine;
+    bool _started { false };
+
+    explicit CoroutineGenerator(Handle coroutine) noexcept
+        : _coroutine { coroutine } {}
+
+    // run the body up to its next co_yield or its end
+    static void resume(Handle coroutine) {
+        coroutine.resume();
+        if (coroutine.done() && coroutine.promise()._exception) {
+            std::rethrow_exception(std::exchange(coroutine.promise()._exception, nullptr));
+        }
+    }
+};
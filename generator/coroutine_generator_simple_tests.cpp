@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <iostream>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "coroutine_generator.h"
+
+auto barGen(std::string str, size_t n) -> CoroutineGenerator<std::string> {
+    for (size_t i = 0; i < n; ++i) {
+        if (i > 8) {
+            co_return;
+        }
+        co_yield str + std::to_string(i);
+    }
+}
+
+auto pairGen() -> CoroutineGenerator<std::pair<std::string, int>> {
+    for (int i = 0; i < 10; ++i) {
+        co_yield { std::to_string(i), i };
+    }
+}
+
+auto failingGen() -> CoroutineGenerator<int> {
+    co_yield 1;
+    throw std::runtime_error("failed after 1");
+}
+
+auto main() -> int {
+    auto gen = []() -> CoroutineGenerator<int> {
+        for (int i = 0; i < 10; ++i) {
+            co_yield i;
+        }
+    }();
+    static_assert(std::ranges::input_range<decltype(gen)>);
+
+    auto it = gen.begin();
+    std::cout << *it << std::endl;
+    std::cout << *(++it) << std::endl;
+    std::for_each(++it, gen.end(), [](int i) { std::cout << i << ' '; });
+
+    std::cout << '\n';
+
+    auto gen2 = pairGen();
+    std::unordered_map<std::string, int> mp(gen2.begin(), gen2.end());
+    for (auto& [k, v] : mp) {
+        std::cout << k << " " << v << "\n";
+    }
+
+    for (const auto& str : barGen("test", 10)) {
+        std::cout << str << '\n';
+    }
+
+    // abandoned halfway: destroying the generator destroys the suspended body
+    auto endless = []() -> CoroutineGenerator<int> {
+        for (int i = 0;; ++i) {
+            co_yield i;
+        }
+    }();
+    for (int i : endless) {
+        if (i == 3) {
+            break;
+        }
+    }
+
+    try {
+        for (int i : failingGen()) {
+            std::cout << i << '\n';
+        }
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << '\n';
+    }
+
+    return 0;
+}
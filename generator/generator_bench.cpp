@@ -0,0 +1,169 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "coroutine_generator.h"
+#include "no_coroutines_generator.h"
+
+/*
+ * Not a test: counts how many values per second get from a generator body to a
+ * range-for loop with each Generator implementation, and how many short generators can be
+ * started and drained per second with and without reusing threads, and how much look-ahead
+ * lets a slow body and a slow consumer overlap.
+ * Usage: generator_bench [value count]
+ */
+
+namespace {
+
+volatile long sink = 0;
+
+auto threaded(long n) -> Generator<long> {
+    return Generator<long> { [n](Generator<long>::Yielder& gen) {
+        for (long i = 0; i < n; ++i) {
+            gen.yield(std::move(i));
+        }
+    } };
+}
+
+auto chunked(long n) -> Generator<long> {
+    auto body = [n](Generator<long>::Yielder& gen) {
+        for (long i = 0; i < n; ++i) {
+            gen.yield(std::move(i));
+        }
+    };
+    return Generator<long> { body, { .chunkSize = 256 } };
+}
+
+auto typedBody(long n) {
+    return make_generator<long>(
+      [n](GeneratorYielder<long>& gen) {
+          for (long i = 0; i < n; ++i) {
+              gen.yield(std::move(i));
+          }
+      },
+      { .chunkSize = 256 });
+}
+
+auto coroutine(long n) -> CoroutineGenerator<long> {
+    for (long i = 0; i < n; ++i) {
+        co_yield i;
+    }
+}
+
+template <typename Make>
+auto bench(const std::string& name, long n, Make make) -> double {
+    auto start = std::chrono::steady_clock::now();
+    long sum { 0 };
+    for (long value : make(n)) {
+        sum += value;
+    }
+    sink = sum;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double rate = static_cast<double>(n) / seconds;
+    std::cout << std::left << std::setw(12) << name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(0) << rate << " values/s\n";
+    return rate;
+}
+
+// the pipeline without adaptors: a generator per stage, each pulling from the last
+auto nestedPipeline(long n) -> Generator<long> {
+    auto tripled = [n](Generator<long>::Yielder& out) {
+        auto evens = [n](Generator<long>::Yielder& gen) {
+            for (long value : chunked(n)) {
+                if (value % 2 == 0) {
+                    gen.yield(std::move(value));
+                }
+            }
+        };
+        for (long value : Generator<long> { evens, { .chunkSize = 256 } }) {
+            out.yield(value * 3);
+        }
+    };
+    return Generator<long> { tripled, { .chunkSize = 256 } };
+}
+
+auto fusedPipeline(long n) -> Generator<long> {
+    return chunked(n).filter([](long value) { return value % 2 == 0; }).map([](long value) { return value * 3; });
+}
+
+auto benchShortLived(const std::string& name, GeneratorExecutor& executor, long generators) -> void {
+    auto body = [](Generator<long>::Yielder& gen) {
+        for (long i = 0; i < 16; ++i) {
+            gen.yield(std::move(i));
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < generators; ++i) {
+        for (long value : Generator<long> { body, { .chunkSize = 16, .executor = &executor } }) {
+            sink = sink + value;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::left << std::setw(12) << name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(0) << static_cast<double>(generators) / seconds << " generators/s\n";
+}
+
+// stands in for a stage that waits on I/O, or burns CPU, for about 100us a value
+auto work(bool cpu) -> void {
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+    if (!cpu) {
+        std::this_thread::sleep_until(until);
+        return;
+    }
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+auto benchStages(const std::string& name, bool cpu, size_t lookAhead) -> void {
+    constexpr long n = 2000;
+    auto body = [cpu](Generator<long>::Yielder& gen) {
+        for (long i = 0; i < n; ++i) {
+            work(cpu);
+            gen.yield(std::move(i));
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (long value : Generator<long> { body, { .lookAhead = lookAhead } }) {
+        work(cpu);
+        sink = sink + value;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::left << std::setw(12) << name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(0) << static_cast<double>(n) / seconds << " values/s\n";
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+    long n = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 100'000;
+
+    // the threaded generator is slow enough that a fraction of the values is plenty
+    double threadedRate = bench("threaded", n, threaded);
+    bench("chunked", n * 100, chunked);
+    bench("typed body", n * 100, typedBody);
+    double coroutineRate = bench("coroutine", n * 1000, coroutine);
+    bench("nested", n * 10, nestedPipeline);
+    bench("fused", n * 10, fusedPipeline);
+    std::cout << "coroutine speedup: " << std::setprecision(0) << coroutineRate / threadedRate << "x\n";
+
+    // with its only worker taken, every other generator on this executor gets a thread
+    GeneratorExecutor busy { 1 };
+    Generator<long> blocker { [](Generator<long>::Yielder& gen) { gen.yield(0); }, { .executor = &busy } };
+    blocker.begin();
+    benchShortLived("own thread", busy, n / 10);
+    benchShortLived("pooled", GeneratorExecutor::shared(), n / 10);
+
+    benchStages("io, strict", false, 0);
+    benchStages("io, ahead 16", false, 16);
+    benchStages("cpu, strict", true, 0);
+    benchStages("cpu, ahead 16", true, 16);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Pool of reusable threads for Generator bodies, so starting a generator doesn't have to
+ * create a thread. Workers are started on demand, up to maxWorkers, and then kept around
+ * for the next body.
+ *
+ * A body holds its worker until it finishes or its Generator is destroyed, so a body
+ * that has to wait for a free worker can only start once another generator is done.
+ * With the default queueCapacity of 0 nothing waits: when every worker is busy the
+ * Generator falls back to a thread of its own. A bigger queue caps the thread count, but
+ * a thread must then never consume more live queued generators at once than there are
+ * workers, or it can wait forever for a body that never starts.
+ */
+class GeneratorExecutor {
+public:
+    explicit GeneratorExecutor(size_t maxWorkers = std::max(std::thread::hardware_concurrency(), 1U),
+                               size_t queueCapacity = 0)
+        : _maxWorkers { std::max<size_t>(maxWorkers, 1) }
+        , _queueCapacity { queueCapacity } {}
+
+    GeneratorExecutor(const GeneratorExecutor&) = delete;
+    auto operator=(const GeneratorExecutor&) -> GeneratorExecutor& = delete;
+
+    /*
+     * Runs everything that was submitted, then stops the workers
+     */
+    ~GeneratorExecutor() {
+        {
+            std::unique_lock lk { _mutex };
+            _stopping = true;
+        }
+        _workAvailable.notify_all();
+        for (auto& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    /*
+     * Executor used by Generators that aren't given one
+     */
+    static auto shared() -> GeneratorExecutor& {
+        static GeneratorExecutor executor { 64 };
+        return executor;
+    }
+
+    /*
+     * Run task on an idle or new worker, or queue it if all maxWorkers are busy and the
+     * queue has room. Returns false, without taking the task, if neither is possible.
+     * The task must not throw.
+     */
+    auto trySubmit(std::function<void()>& task) -> bool {
+        std::unique_lock lk { _mutex };
+        // queued tasks that no idle worker is going to pick up
+        size_t backlog = _queue.size() > _idle ? _queue.size() - _idle : 0;
+        bool unclaimedWorker = _idle > _queue.size();
+        if (!unclaimedWorker && _workers.size() == _maxWorkers && backlog >= _queueCapacity) {
+            return false;
+        }
+
+        _queue.push_back(std::move(task));
+        if (unclaimedWorker) {
+            _workAvailable.notify_one();
+        } else if (_workers.size() < _maxWorkers) {
+            _workers.emplace_back([this] { work(); });
+        }
+        return true;
+    }
+
+    [[nodiscard]] auto workers() -> size_t {
+        std::unique_lock lk { _mutex };
+        return _workers.size();
+    }
+
+private:
+    auto work() -> void {
+        std::unique_lock lk { _mutex };
+        while (true) {
+            ++_idle;
+            _workAvailable.wait(lk, [&] { return _stopping || !_queue.empty(); });
+            --_idle;
+            if (_queue.empty()) {
+                return;
+            }
+
+            auto task = std::move(_queue.front());
+            _queue.pop_front();
+            lk.unlock();
+            task();
+            lk.lock();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::deque<std::function<void()>> _queue;
+    std::vector<std::thread> _workers;
+    size_t _maxWorkers;
+    size_t _queueCapacity;
+    size_t _idle { 0 };
+    bool _stopping { false };
+};
@@ -1,142 +1,361 @@
 #pragma once
 
 #include <algorithm>
-#include <condition_variable>
+#include <atomic>
+#include <bit>
 #include <exception>
 #include <functional>
 #include <iostream>
-#include <mutex>
+#include <iterator>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <print>
+#include <span>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "generator_executor.h"
 
 template <typename T>
-class Generator {
+class GeneratorYielder;
+
+/*
+ * Body is the type of the generator's body, a callable taking a GeneratorYielder<T>&.
+ * Generator<T> wraps it in a std::function so generators with different bodies have the
+ * same type; make_generator keeps the body's own type.
+ */
+template <typename T, typename Body = std::function<void(GeneratorYielder<T>&)>>
+class Generator;
+
+struct GeneratorOptions {
+    // values the body collects before the consumer is told about them
+    size_t chunkSize = 1;
+    // values the body may produce before they're asked for, at least chunkSize - 1;
+    // with 0 the body only continues past a yield once the next value is requested
+    size_t lookAhead = 0;
+    // rounds a thread waiting for the other side spins or yields before it sleeps
+    size_t spins = 64;
+    // where the body runs; GeneratorExecutor::shared() if not set
+    GeneratorExecutor* executor = nullptr;
+};
+
+template <typename T>
+class GeneratorYielder {
 public:
-    class Yielder {
-    public:
-        /*
-         * Emit an rvalue from the generator
-         */
-        auto yield(T&& val) -> void {
-            if (_endGen) {
-                yield_break();
-                return;
+    /*
+     * Emit an rvalue from the generator
+     */
+    auto yield(T&& val) -> void { yield_many(std::span<T> { &val, 1 }); }
+
+    /*
+     * Emit every value in values, in order, moving them out of the span. Cheaper
+     * than calling yield for each of them when the generator is chunked.
+     */
+    auto yield_many(std::span<T> values) -> void {
+        if (_sink) {
+            for (size_t i = 0; i < values.size() && !_stopped; ++i) {
+                if (!_sinkFn(_sink, std::move(values[i]))) {
+                    // unwind the fused body instead of letting it run to its end
+                    _stopped = true;
+                    throw Stop {};
+                }
+            }
+            return;
+        }
+        for (size_t i = 0; i < values.size() && !_stopped; ++i) {
+            _slots[_written & _mask] = std::move(values[i]);
+            ++_written;
+            if (_written >= _knownRequests + _lookAhead) {
+                // out of room: everything so far goes to the consumer, which has to
+                // ask for more before the body can go on
+                publish(_written);
+                awaitRequests();
+            } else if (_written - _published >= _chunkSize) {
+                publish(_written);
             }
+        }
+    }
+
+    /*
+     * End the generator without eitting a value. Return may also be used
+     * instead of this function. Values yielded before it are still emitted.
+     */
+    auto yield_break() -> void {
+        if (!_stopped) {
+            _stopped = true;
+            if (!_sink) {
+                publish(_written | doneBit);
+            }
+        }
+    }
+
+private:
+    // thrown out of a body's yield once nothing wants its values any more: the
+    // consumer went away, or a fused adaptor's sink refused a value. Caught where the
+    // body was started or fused; not a std::exception, so bodies don't catch it.
+    struct Stop {};
+
+    // set in _tail once the producer is done, and in _requested once the consumer is
+    static constexpr size_t doneBit = size_t { 1 } << (sizeof(size_t) * 8 - 1);
+
+    explicit GeneratorYielder(const GeneratorOptions& options)
+        : _chunkSize { std::max<size_t>(options.chunkSize, 1) }
+        , _lookAhead { std::max(options.lookAhead, _chunkSize - 1) }
+        , _spins { options.spins }
+        , _mask { std::bit_ceil(_lookAhead + 1) - 1 }
+        , _slots { std::make_unique<std::optional<T>[]>(_mask + 1) } {}
+
+    /*
+     * Yielder of a body fused into another generator's body: every value goes
+     * straight to sink, which returns false once it doesn't want any more. sink has
+     * to outlive the yielder.
+     */
+    template <typename Sink>
+        requires std::is_invocable_r_v<bool, Sink&, T&&>
+    explicit GeneratorYielder(Sink& sink)
+        : _chunkSize { 1 }
+        , _lookAhead { 0 }
+        , _spins { 0 }
+        , _mask { 0 }
+        , _sink { &sink }
+        , _sinkFn { [](void* sink, T&& value) -> bool { return (*static_cast<Sink*>(sink))(std::move(value)); } } {}
 
-            _currVal = std::move(val);
-            _hasNextValue = true;
-            _getNext = false;
-            _yieldCv.notify_one();
+    GeneratorYielder(const GeneratorYielder&) = delete;
+    auto operator=(const GeneratorYielder&) -> GeneratorYielder& = delete;
+
+    /*
+     * Until ready accepts counter's value: spin a few rounds with exponential
+     * backoff, then yield the CPU for the rest of the spins rounds, then sleep. The
+     * busy spinning is skipped on a single CPU, where it can only delay the other side.
+     */
+    template <typename Ready>
+    auto await(const std::atomic<size_t>& counter, Ready ready) const -> size_t {
+        static const size_t busyRounds = std::thread::hardware_concurrency() > 1 ? 4 : 0;
 
-            std::unique_lock lk { _yielding };
-            _yieldCv.wait(lk, [&] { return _getNext || _endGen; });
+        size_t value = counter.load(std::memory_order_acquire);
+        for (size_t spin = 0; !ready(value); ++spin) {
+            if (spin < std::min(busyRounds, _spins)) {
+                for (size_t i = 0; i < (size_t { 1 } << spin); ++i) {
+#if defined(__x86_64__) || defined(__i386__)
+                    __builtin_ia32_pause();
+#endif
+                }
+            } else if (spin < _spins) {
+                std::this_thread::yield();
+            } else {
+                counter.wait(value, std::memory_order_acquire);
+            }
+            value = counter.load(std::memory_order_acquire);
         }
+        return value;
+    }
+
+    auto publish(size_t tail) -> void {
+        _published = tail & ~doneBit;
+        _tail.store(tail, std::memory_order_release);
+        _tail.notify_one();
+    }
 
-        /*
-         * End the generator without eitting a value. Return may also be used
-         * instead of this function.
-         */
-        auto yield_break() -> void {
-            _currVal = std::nullopt;
-            _hasNextValue = true;
-            _getNext = false;
-            _endGen = true;
-            _yieldCv.notify_one();
+    /*
+     * Wait until the consumer has asked for enough values that the producer is back
+     * within its look-ahead, or has gone away
+     */
+    auto awaitRequests() -> void {
+        size_t requested = await(_requested, [&](size_t requested) {
+            return (requested & doneBit) || _written < requested + _lookAhead;
+        });
+        _knownRequests = requested & ~doneBit;
+        if (requested & doneBit) {
+            // the consumer is gone, so unwind the body instead of letting it run on
+            _stopped = true;
+            throw Stop {};
         }
+    }
 
-    private:
-        /*
-         * Signal to the yielder that the next value is requested
-         */
-        auto getNext() -> void {
-            _currVal = std::nullopt;
-            _getNext = true;
-            _hasNextValue = false;
-            _yieldCv.notify_one();
+    /*
+     * Move the consumer to the next value, waiting for the producer if it isn't there
+     * yet. Returns false at the end.
+     */
+    auto advance() -> bool {
+        if (_finished) {
+            return false;
+        }
+        if (_taken > 0) {
+            // the producer can only reuse the slot once the request below is published
+            _slots[(_taken - 1) & _mask].reset();
         }
+        size_t index = _taken++;
+        _requested.store(_taken, std::memory_order_release);
+        _requested.notify_one();
 
-        /*
-         * Signal to the yielder that it should stop waiting for the
-         * next signal. In other words, it stops the generator.
-         */
-        auto signalEnd() -> void {
-            _endGen = true;
-            _yieldCv.notify_one();
+        size_t tail = await(_tail, [&](size_t tail) { return (tail & ~doneBit) > index || (tail & doneBit); });
+        if ((tail & ~doneBit) <= index) {
+            _finished = true;
+            return false;
         }
+        return true;
+    }
 
-        std::mutex _yielding;
-        std::condition_variable _yieldCv;
-        std::optional<T> _currVal;
-        bool _hasNextValue = false;
-        bool _endGen = false;
-        bool _getNext = false;
+    /*
+     * The value the consumer is on. It stays in its slot until the consumer advances,
+     * since the producer never gets far enough ahead to reuse it.
+     */
+    [[nodiscard]] auto current() const -> const T& { return *_slots[(_taken - 1) & _mask]; }
 
-        friend class Generator;
-    };
+    [[nodiscard]] auto cancelled() const noexcept -> bool {
+        return _requested.load(std::memory_order_acquire) & doneBit;
+    }
+
+    /*
+     * Signal to the yielder that it should stop waiting for the
+     * next signal. In other words, it stops the generator.
+     */
+    auto signalEnd() -> void {
+        _requested.fetch_or(doneBit, std::memory_order_release);
+        _requested.notify_one();
+    }
+
+    // values written by the producer, and values asked for by the consumer; each
+    // side only writes its own counter, and they sit on separate cache lines
+    alignas(64) std::atomic<size_t> _tail { 0 };
+    alignas(64) std::atomic<size_t> _requested { 0 };
+
+    // the producer's side
+    alignas(64) size_t _written { 0 };
+    size_t _knownRequests { 0 };
+    size_t _published { 0 };
+    bool _stopped { false };
 
+    // the consumer's side
+    alignas(64) size_t _taken { 0 };
+    bool _finished { false };
+
+    // the consumer holds or waits for at least one value, and the producer is at
+    // most _lookAhead values past it, so that many slots plus one (rounded up to a
+    // power of two) are enough
+    alignas(64) size_t _chunkSize;
+    size_t _lookAhead;
+    size_t _spins;
+    size_t _mask;
+    std::unique_ptr<std::optional<T>[]> _slots;
+    void* _sink { nullptr };
+    bool (*_sinkFn)(void*, T&&) { nullptr };
+
+    template <typename, typename>
+    friend class Generator;
+};
+
+template <typename T, typename Body>
+class Generator {
+public:
+    using Options = GeneratorOptions;
+    using Yielder = GeneratorYielder<T>;
+
+    /*
+     * Single pass: every iterator of a generator shares its position, so only
+     * comparisons with end() are meaningful
+     */
     class GeneratorIterator {
     public:
-        using iterator_category = std::forward_iterator_tag;
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept = std::input_iterator_tag;
         using difference_type = std::ptrdiff_t;
         using value_type = T;
-        using pointer = value_type*;
-        using reference = value_type&;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        GeneratorIterator() = default;
 
-        auto operator*() const -> const value_type& { return _val.value(); }
-        auto operator->() -> pointer { return &_val.value(); }
+        auto operator*() const -> reference { return _gen->_yielder.current(); }
+        auto operator->() const -> pointer { return &_gen->_yielder.current(); }
 
         auto operator++() -> GeneratorIterator& {
-            _val = std::move(_next());
+            if (!_gen->_yielder.advance()) {
+                _gen = nullptr;
+            }
             return *this;
         }
 
-        auto operator++(int) -> GeneratorIterator {
-            GeneratorIterator tmp = *this;
-            ++(*this);
-            return tmp;
-        }
+        auto operator++(int) -> void { ++(*this); }
 
         friend auto operator==(const GeneratorIterator& a, const GeneratorIterator& b) -> bool {
-            return a._gen == b._gen && a._val == b._val;
-        };
-        friend auto operator!=(const GeneratorIterator& a, const GeneratorIterator& b) -> bool {
-            return a._gen != b._gen || a._val != b._val;
+            return a._gen == b._gen;
         };
 
     private:
-        std::optional<value_type> _val;
-        std::function<std::optional<value_type>()> _next;
-        Generator* _gen;
-
-        GeneratorIterator(std::optional<value_type> val, const std::function<std::optional<value_type>()>& next,
-                          Generator* gen) noexcept
-            : _val { std::move(val) }
-            , _next(next)
-            , _gen(gen) {}
+        // null once the generator is done, like the end() iterator
+        Generator* _gen { nullptr };
+
+        explicit GeneratorIterator(Generator* gen) noexcept
+            : _gen(gen) {}
         friend class Generator;
     };
 
-    Generator(const std::function<void(Yielder&)>& gen)
-        : _genFun(gen)
-        , _yielder() {}
+    /*
+     * With a chunkSize above 1 values are handed to the consumer that many at a time.
+     * With a lookAhead the body keeps producing while the consumer works, until it's
+     * lookAhead values ahead. Values are passed through a lock-free ring, and a side
+     * that has to wait for the other spins for up to spins rounds before sleeping.
+     */
+    Generator(Body gen, Options options = {})
+        : _genFun(std::move(gen))
+        , _options(options)
+        , _yielder(options) {
+        if (_options.executor == nullptr) {
+            _options.executor = &GeneratorExecutor::shared();
+        }
+    }
 
-    Generator(const Generator<T>& other)
+    Generator(const Generator& other)
         : _genFun(other._genFun)
-        , _yielder(Yielder()) {}
+        , _options(other._options)
+        , _yielder(other._options) {}
+
+    /*
+     * Takes over an unstarted generator's body. A started one keeps its body, which is
+     * still running, so this gets a copy and starts over like a copied generator.
+     */
+    Generator(Generator&& other) noexcept
+        : _genFun(other._bodyDone ? Body(other._genFun) : std::move(other._genFun))
+        , _options(other._options)
+        , _yielder(other._options) {}
 
-    Generator(const Generator<T>&& other) noexcept
-        : _genFun(std::move(other._genFun))
-        , _yielder(Yielder()) {}
+    /*
+     * Copy of a generator with another body type, e.g. an adaptor's result stored as a
+     * type-erased Generator<T>
+     */
+    template <typename OtherBody>
+        requires(!std::is_same_v<OtherBody, Body> && std::is_constructible_v<Body, const OtherBody&>)
+    Generator(const Generator<T, OtherBody>& other)
+        : _genFun(other._genFun)
+        , _options(other._options)
+        , _yielder(other._options) {}
 
-    auto operator=(const Generator<T>& other) = delete;
-    auto operator=(const Generator<T>&& other) = delete;
+    auto operator=(const Generator& other) = delete;
+
+    /*
+     * Stops this generator's body, if it was started, and takes over other's the way
+     * the move constructor does. The yielder can't be reassigned and a lambda body
+     * can't be either, so the generator is destroyed and rebuilt in place.
+     */
+    auto operator=(Generator&& other) noexcept -> Generator& {
+        if (this != &other) {
+            std::destroy_at(this);
+            ::new (static_cast<void*>(this)) Generator(std::move(other));
+        }
+        return *this;
+    }
 
     ~Generator() {
-        if (_genThread.has_value()) {
+        if (_bodyDone) {
             _yielder.signalEnd();
+            _bodyDone->wait(false, std::memory_order_acquire);
+        }
+        if (_genThread.has_value()) {
             _genThread->join();
         }
     }
@@ -147,40 +366,164 @@ public:
      * an exception will be raised.
      */
     auto begin() -> GeneratorIterator {
-        if (_genThread) {
+        if (_bodyDone) {
             throw std::runtime_error("Generator is already being consumed");
         }
 
-        _genThread = std::thread([&] {
-            try {
-                _genFun(_yielder);
-            } catch (const std::exception& e) {
-                std::cerr << e.what() << '\n';
+        // shared with the body, which may still be signalling it when this is destroyed
+        _bodyDone = std::make_shared<std::atomic<bool>>(false);
+        std::function<void()> body = [this, done = _bodyDone] {
+            // the generator may have been destroyed while the body was queued
+            if (!_yielder.cancelled()) {
+                try {
+                    _genFun(_yielder);
+                } catch (const typename Yielder::Stop&) {
+                    // the consumer went away while the body was yielding
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << '\n';
+                }
             }
             _yielder.yield_break();
-        });
+            done->store(true, std::memory_order_release);
+            done->notify_one();
+        };
+        if (!_options.executor->trySubmit(body)) {
+            _genThread = std::thread(std::move(body));
+        }
 
-        std::unique_lock lk { _yielder._yielding };
-        _yielder._yieldCv.wait(lk, [&] { return _yielder._currVal; });
-        return GeneratorIterator { _yielder._currVal,
-                                   [&]() {
-                                       _yielder.getNext();
-                                       std::unique_lock lk { _yielder._yielding };
-                                       _yielder._yieldCv.wait(lk, [&] { return _yielder._hasNextValue; });
-                                       return std::move(_yielder._currVal);
-                                   },
-                                   this };
+        return GeneratorIterator { _yielder.advance() ? this : nullptr };
     }
 
     /*
      * Iterator to indicate the end of the generation stream
      */
-    auto end() -> GeneratorIterator {
-        return GeneratorIterator { std::nullopt, [] { return std::nullopt; }, this };
+    auto end() -> GeneratorIterator { return GeneratorIterator {}; }
+
+    /*
+     * Lazy adaptors. They don't consume this generator: each returns a new one whose
+     * body runs this generator's body with every value passed through the adaptor, so
+     * a whole pipeline runs in a single body instead of a thread per stage.
+     */
+
+    template <typename F>
+    [[nodiscard]] auto map(F f) const {
+        using U = std::remove_cvref_t<std::invoke_result_t<F&, T&&>>;
+        return fuse<U>([f](GeneratorYielder<U>& out, T&& value) mutable {
+            out.yield(U(std::invoke(f, std::move(value))));
+            return !out._stopped;
+        });
+    }
+
+    template <typename Pred>
+    [[nodiscard]] auto filter(Pred pred) const {
+        return fuse<T>([pred](Yielder& out, T&& value) mutable {
+            if (std::invoke(pred, std::as_const(value))) {
+                out.yield(std::move(value));
+            }
+            return !out._stopped;
+        });
+    }
+
+    /*
+     * The first n values. The body is unwound out of the yield of the nth, so
+     * take also ends generators whose body never returns.
+     */
+    [[nodiscard]] auto take(size_t n) const {
+        return fuse<T>([n](Yielder& out, T&& value) mutable {
+            if (n == 0) {
+                return false;
+            }
+            out.yield(std::move(value));
+            return --n > 0 && !out._stopped;
+        });
+    }
+
+    /*
+     * Groups of n values, the last one possibly shorter
+     */
+    [[nodiscard]] auto chunk(size_t n) const {
+        n = std::max<size_t>(n, 1);
+        auto chunked = [body = _genFun, n](GeneratorYielder<std::vector<T>>& out) mutable {
+            std::vector<T> group;
+            auto sink = [&](T&& value) {
+                group.push_back(std::move(value));
+                if (group.size() == n) {
+                    out.yield(std::exchange(group, {}));
+                }
+                return !out._stopped;
+            };
+            Yielder in { sink };
+            try {
+                body(in);
+            } catch (const typename Yielder::Stop&) {
+                out.yield_break();
+                return;
+            }
+            if (!group.empty()) {
+                out.yield(std::move(group));
+            }
+        };
+        return Generator<std::vector<T>, decltype(chunked)> { std::move(chunked), _options };
+    }
+
+    /*
+     * Pairs of values from this generator and a copy of other, until either ends.
+     * Unlike the other adaptors this needs two bodies running at once, so other's body
+     * gets its own worker and is pulled from inside this one.
+     */
+    template <typename U, typename OtherBody>
+    [[nodiscard]] auto zip(const Generator<U, OtherBody>& other) const {
+        Generator<U, OtherBody> rhs { other };
+        return fuse<std::pair<T, U>>(
+          [rhs = std::move(rhs), it = typename Generator<U, OtherBody>::GeneratorIterator {}, started = false](
+            GeneratorYielder<std::pair<T, U>>& out, T&& value) mutable {
+              if (!started) {
+                  it = rhs.begin();
+                  started = true;
+              }
+              if (it == rhs.end()) {
+                  return false;
+              }
+              out.yield({ std::move(value), *it });
+              ++it;
+              return !out._stopped;
+          });
     }
 
 private:
-    std::function<void(Yielder&)> _genFun;
+    template <typename, typename>
+    friend class Generator;
+
+    /*
+     * Generator<U> running this body, with each value passed to step(out, value)
+     * instead of being emitted; once step returns false the body is unwound from its
+     * yield and the new generator ends
+     */
+    template <typename U, typename Step>
+    auto fuse(Step step) const {
+        auto fused = [body = _genFun, step](GeneratorYielder<U>& out) mutable {
+            // a fresh copy every run, since step can keep state
+            Step run = step;
+            auto sink = [&](T&& value) { return run(out, std::move(value)); };
+            Yielder in { sink };
+            try {
+                body(in);
+            } catch (const typename Yielder::Stop&) {
+                out.yield_break();
+            }
+        };
+        return Generator<U, decltype(fused)> { std::move(fused), _options };
+    }
+
+    Body _genFun;
+    Options _options;
     Yielder _yielder;
+    std::shared_ptr<std::atomic<bool>> _bodyDone;
+    // only used when the executor had no room for the body
     std::optional<std::thread> _genThread;
 };
+
+template <typename T, typename Body>
+[[nodiscard]] auto make_generator(Body body, GeneratorOptions options = {}) -> Generator<T, Body> {
+    return Generator<T, Body> { std::move(body), options };
+}
@@ -1,7 +1,9 @@
+#include <ranges>
+
 #include "no_coroutines_generator.h"
 
 auto barGen(const std::string& str, size_t n) -> Generator<std::string> {
-    return Generator<std::string> { [&str, n](Generator<std::string>::Yielder& gen) {
+    return Generator<std::string> { [str, n](Generator<std::string>::Yielder& gen) {
         for (size_t i = 0; i < n; ++i) {
             if (i > 8) {
                 gen.yield_break();
@@ -43,5 +45,91 @@ auto main() -> int {
 
     auto freshGen = gen2;
 
+    // handed over 4 at a time, but consumed in the same order
+    auto chunked = Generator<int> {
+        [](Generator<int>::Yielder& gen) {
+            std::vector<int> nums = { 1, 2, 3, 4, 5, 6 };
+            gen.yield_many(nums);
+            gen.yield(7);
+            gen.yield_break();
+            gen.yield(8);
+        },
+        { .chunkSize = 4 }
+    };
+    for (int i : chunked) {
+        std::cout << i << ' ';
+    }
+    std::cout << '\n';
+
+    // one body runs the whole pipeline
+    auto squares = gen.filter([](int i) { return i % 2 == 1; }).map([](int i) { return i * i; }).take(3);
+    for (const auto& group : squares.chunk(2)) {
+        std::cout << group.size() << ": " << group.front() << '\n';
+    }
+    for (const auto& [str, i] : barGen("zip", 3).zip(gen)) {
+        std::cout << str << ' ' << i << '\n';
+    }
+    for (int i : squares | std::views::transform([](int i) { return -i; })) {
+        std::cout << i << ' ';
+    }
+    std::cout << '\n';
+
+    // a temporary generator is moved into the view, which then owns it
+    static_assert(std::ranges::viewable_range<Generator<std::string>>);
+    for (const auto& str : barGen("owned", 5) | std::views::take(2) | std::views::transform([](auto s) { return s + '!'; })) {
+        std::cout << str << ' ';
+    }
+    // assigning over a started generator stops its body first
+    auto reassigned = barGen("old", 5);
+    reassigned.begin();
+    reassigned = barGen("new", 2);
+    for (const auto& str : reassigned) {
+        std::cout << str << ' ';
+    }
+    std::cout << '\n';
+
+    // take ends a body that never returns, and zip stops once its shorter side ends
+    auto naturals = Generator<int> { [](Generator<int>::Yielder& gen) {
+        for (int i = 0;; ++i) {
+            gen.yield(std::move(i));
+        }
+    } };
+    for (int i : naturals.take(3)) {
+        std::cout << i << ' ';
+    }
+    for (const auto& [i, str] : naturals.zip(barGen("z", 2))) {
+        std::cout << str << ' ';
+    }
+    for (const auto& group : naturals.chunk(2).take(2)) {
+        std::cout << group.back() << ' ';
+    }
+    std::cout << '\n';
+
+    // either side of a zip may be the endless one
+    auto three = Generator<int> { [](Generator<int>::Yielder& gen) {
+        for (int i = 0; i < 3; ++i) {
+            gen.yield(std::move(i));
+        }
+    } };
+    for (const auto& [a, b] : three.zip(naturals)) {
+        std::cout << a << ' ' << b << '\n';
+    }
+    for (const auto& [a, b] : naturals.zip(three)) {
+        std::cout << a << ' ' << b << '\n';
+    }
+
+    // the body keeps its own type instead of going through a std::function
+    auto typed = make_generator<int>([](GeneratorYielder<int>& gen) {
+        for (int i = 0; i < 3; ++i) {
+            gen.yield(std::move(i));
+        }
+    });
+    static_assert(std::ranges::input_range<decltype(typed)>);
+    static_assert(std::movable<decltype(typed)>);
+    for (int i : typed.map([](int i) { return i * 10; })) {
+        std::cout << i << ' ';
+    }
+    std::cout << '\n';
+
     return 0;
 }
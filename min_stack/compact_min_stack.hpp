@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+/*
+ * MinStack that doesn't store a minimum next to every element. The values sit in one
+ * buffer, and a second stack holds the positions of the elements that were a new
+ * minimum when they were pushed. An element that isn't smaller than the current minimum
+ * (including an equal one) costs nothing extra, and popping an element only has to
+ * check whether its position is the top of the minima stack.
+ *
+ * Memory is sizeof(T) per element plus a position per new minimum, so it never holds a
+ * payload twice, which is what matters for large T. A strictly decreasing input makes
+ * every element a new minimum and is the worst case, at sizeof(T) + sizeof(size_t).
+ */
+template <typename T, typename Compare = std::less<T>>
+class CompactMinStack {
+    std::vector<T> _values;
+    std::vector<size_t> _minima;
+
+public:
+    template <typename Iter>
+    CompactMinStack(Iter begin, Iter end) {
+        for (; begin != end; ++begin) {
+            this->push(*begin);
+        }
+    }
+
+    CompactMinStack() = default;
+
+    auto push(const T& item) -> void {
+        if (_minima.empty() || Compare {}(item, _values[_minima.back()])) {
+            _minima.push_back(_values.size());
+        }
+        _values.push_back(item);
+    }
+
+    [[nodiscard]] auto top() const noexcept -> std::optional<T> {
+        if (_values.empty()) {
+            return {};
+        }
+        return _values.back();
+    }
+
+    auto pop() -> void {
+        if (_values.empty()) {
+            return;
+        }
+        _values.pop_back();
+        if (_minima.back() == _values.size()) {
+            _minima.pop_back();
+        }
+    }
+
+    [[nodiscard]] auto getMin() const -> std::optional<T> {
+        if (_minima.empty()) {
+            return {};
+        }
+        return _values[_minima.back()];
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _values.size(); }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return _values.empty(); }
+
+    /*
+     * Bytes of element and minima storage currently allocated
+     */
+    [[nodiscard]] auto memoryUsage() const noexcept -> size_t {
+        return _values.capacity() * sizeof(T) + _minima.capacity() * sizeof(size_t);
+    }
+};
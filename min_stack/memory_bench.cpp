@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "compact_min_stack.hpp"
+#include "min_stack.hpp"
+
+/*
+ * Not a test: pushes the same inputs onto MinStack and CompactMinStack and compares the
+ * memory they hold and the time for pushing and popping everything, then times building
+ * and throwing away many small stacks with heap, inline and fixed storage.
+ * Usage: memory_bench [element count]
+ */
+
+namespace {
+
+// stand-in for a large key, ordered by its first word
+struct Wide {
+    std::array<long, 8> words {};
+
+    auto operator<(const Wide& other) const -> bool { return words[0] < other.words[0]; }
+};
+
+volatile long sink = 0;
+
+template <typename Stack, typename T>
+void bench(const std::string& name, const std::vector<T>& values) {
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    Stack stack;
+    for (const T& value : values) {
+        stack.push(value);
+    }
+    size_t bytes = stack.memoryUsage();
+    while (!stack.empty()) {
+        stack.pop();
+        if (!stack.empty()) {
+            sink = sink + (stack.getMin().value() < values.front());
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    auto count = static_cast<double>(values.size());
+    std::cout << "  " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << static_cast<double>(bytes) / count << " bytes/elem" << std::setw(8) << ns / count
+              << " ns/elem\n";
+}
+
+template <typename T>
+void compare(const std::string& input, const std::vector<T>& values) {
+    std::cout << input << "\n";
+    bench<MinStack<T>>("pairs", values);
+    bench<CompactMinStack<T>>("compact", values);
+}
+
+template <typename T, typename Make>
+void inputs(const std::string& type, size_t count, Make make) {
+    std::mt19937 mt { 42 };
+    std::uniform_int_distribution<long> dist;
+    std::vector<long> keys(count);
+
+    std::ranges::generate(keys, [n = 0L]() mutable { return n++; });
+    std::vector<T> values(count);
+    std::ranges::transform(keys, values.begin(), make);
+    compare(type + ", rising", values);
+
+    std::ranges::generate(keys, [&] { return dist(mt); });
+    std::ranges::transform(keys, values.begin(), make);
+    compare(type + ", random", values);
+
+    // every element is a new minimum
+    std::ranges::generate(keys, [n = static_cast<long>(count)]() mutable { return n--; });
+    std::ranges::transform(keys, values.begin(), make);
+    compare(type + ", falling", values);
+    std::cout << "\n";
+}
+
+// a short-lived stack per iteration, like a parser's scratch space
+template <typename Stack>
+void benchScratch(const std::string& name, const std::vector<long>& values, size_t depth) {
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    size_t rounds = values.size() / depth;
+    for (size_t round = 0; round < rounds; ++round) {
+        Stack stack;
+        for (size_t i = round * depth; i < (round + 1) * depth; ++i) {
+            stack.push(values[i]);
+        }
+        sink = sink + stack.getMin().value();
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    std::cout << "  " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << ns / static_cast<double>(rounds) << " ns/stack\n";
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+
+    inputs<long>("8 byte keys", count, [](long key) { return key; });
+    inputs<Wide>("64 byte keys", count, [](long key) { return Wide { { key } }; });
+
+    std::vector<long> values(count);
+    std::mt19937 mt { 42 };
+    std::ranges::generate(values, [&, dist = std::uniform_int_distribution<long> {}]() mutable { return dist(mt); });
+    constexpr size_t depth = 16;
+    std::cout << "stacks of " << depth << " 8 byte keys\n";
+    benchScratch<MinStack<long>>("heap", values, depth);
+    benchScratch<MinStack<long, std::less<long>, 2 * depth>>("inline", values, depth);
+    benchScratch<FixedMinStack<long, 2 * depth>>("fixed", values, depth);
+    return 0;
+}
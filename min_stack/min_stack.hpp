@@ -1,10 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
 #include <iterator>
+#include <memory>
 #include <optional>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-template <typename T, typename Compare = std::less<T>>
+/*
+ * The part of std::vector that MinStack uses, with room for N elements inside the object
+ * itself. Only growing past N allocates.
+ */
+template <typename Elem, size_t N>
+class InlineBuffer {
+    alignas(Elem) std::byte _inline[N * sizeof(Elem)];
+    Elem* _data { inlineData() };
+    size_t _size { 0 };
+    size_t _capacity { N };
+
+    [[nodiscard]] auto inlineData() noexcept -> Elem* { return reinterpret_cast<Elem*>(_inline); }
+
+    [[nodiscard]] auto spilled() const noexcept -> bool { return _capacity > N; }
+
+    void grow() {
+        std::allocator<Elem> allocator;
+        size_t capacity = _capacity * 2;
+        Elem* data = allocator.allocate(capacity);
+        try {
+            std::uninitialized_move_n(_data, _size, data);
+        } catch (...) {
+            allocator.deallocate(data, capacity);
+            throw;
+        }
+        std::destroy_n(_data, _size);
+        if (spilled()) {
+            allocator.deallocate(_data, _capacity);
+        }
+        _data = data;
+        _capacity = capacity;
+    }
+
+    // destroy everything and go back to the inline storage
+    void reset() noexcept {
+        std::destroy_n(_data, _size);
+        if (spilled()) {
+            std::allocator<Elem> {}.deallocate(_data, _capacity);
+        }
+        _data = inlineData();
+        _size = 0;
+        _capacity = N;
+    }
+
+    // take other's elements, leaving it empty; this must be empty and inline
+    void steal(InlineBuffer& other) noexcept(std::is_nothrow_move_constructible_v<Elem>) {
+        if (other.spilled()) {
+            _data = std::exchange(other._data, other.inlineData());
+            _capacity = std::exchange(other._capacity, N);
+            _size = std::exchange(other._size, 0);
+            return;
+        }
+        std::uninitialized_move_n(other._data, other._size, _data);
+        _size = other._size;
+        other.reset();
+    }
+
+public:
+    InlineBuffer() = default;
+
+    InlineBuffer(InlineBuffer&& other) noexcept(std::is_nothrow_move_constructible_v<Elem>) { steal(other); }
+
+    auto operator=(InlineBuffer&& other) noexcept(std::is_nothrow_move_constructible_v<Elem>) -> InlineBuffer& {
+        if (this != &other) {
+            reset();
+            steal(other);
+        }
+        return *this;
+    }
+
+    InlineBuffer(const InlineBuffer&) = delete;
+    auto operator=(const InlineBuffer&) -> InlineBuffer& = delete;
+
+    ~InlineBuffer() { reset(); }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args) {
+        if (_size < _capacity) {
+            std::construct_at(_data + _size, std::forward<Args>(args)...);
+        } else {
+            // args can refer to an element, so build the new one before moving them
+            Elem elem { std::forward<Args>(args)... };
+            grow();
+            std::construct_at(_data + _size, std::move(elem));
+        }
+        ++_size;
+    }
+
+    void pop_back() noexcept { std::destroy_at(_data + --_size); }
+
+    [[nodiscard]] auto back() noexcept -> Elem& { return _data[_size - 1]; }
+    [[nodiscard]] auto back() const noexcept -> const Elem& { return _data[_size - 1]; }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _size; }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return _size == 0; }
+
+    [[nodiscard]] auto capacity() const noexcept -> size_t { return _capacity; }
+
+    /*
+     * Bytes allocated on the heap, so 0 until the buffer outgrows its inline storage
+     */
+    [[nodiscard]] auto heapUsage() const noexcept -> size_t { return spilled() ? _capacity * sizeof(Elem) : 0; }
+};
+
+/*
+ * With an InlineCapacity, the first InlineCapacity elements are stored inside the
+ * MinStack, so a small stack can live on the stack or in scratch space without ever
+ * allocating.
+ */
+template <typename T, typename Compare = std::less<T>, size_t InlineCapacity = 0>
 class MinStack {
-    std::vector<std::pair<T, T>> _stack;
+    using Storage = std::conditional_t<InlineCapacity == 0, std::vector<std::pair<T, T>>,
+                                       InlineBuffer<std::pair<T, T>, InlineCapacity>>;
+
+    Storage _stack;
 
 public:
     template <typename Iter>
@@ -16,11 +138,18 @@ public:
 
     MinStack() = default;
 
-    MinStack(MinStack&&) = delete;
+    MinStack(MinStack&&) noexcept(std::is_nothrow_move_constructible_v<Storage>) = default;
     auto operator=(const MinStack&) -> MinStack& = delete;
-    auto operator=(MinStack&& other) noexcept -> MinStack& = default;
-    explicit MinStack(std::vector<std::pair<T, T>> stack)
-        : _stack(std::move(stack)) {}
+    auto operator=(MinStack&& other) noexcept(std::is_nothrow_move_assignable_v<Storage>) -> MinStack& = default;
+    explicit MinStack(std::vector<std::pair<T, T>> stack) {
+        if constexpr (InlineCapacity == 0) {
+            _stack = std::move(stack);
+        } else {
+            for (auto& entry : stack) {
+                _stack.emplace_back(std::move(entry));
+            }
+        }
+    }
     MinStack(const MinStack& ms) = delete;
     ~MinStack() = default;
 
@@ -56,4 +185,70 @@ public:
     [[nodiscard]] auto size() const noexcept -> size_t { return _stack.size(); }
 
     [[nodiscard]] auto empty() const noexcept -> bool { return _stack.size() == 0; }
+
+    /*
+     * Bytes of heap storage currently allocated
+     */
+    [[nodiscard]] auto memoryUsage() const noexcept -> size_t {
+        if constexpr (InlineCapacity == 0) {
+            return _stack.capacity() * sizeof(std::pair<T, T>);
+        } else {
+            return _stack.heapUsage();
+        }
+    }
+};
+
+/*
+ * MinStack with room for exactly Capacity elements inside the object. It never
+ * allocates and works in constant expressions, but T has to be default constructible.
+ */
+template <typename T, size_t Capacity, typename Compare = std::less<T>>
+class FixedMinStack {
+    std::array<std::pair<T, T>, Capacity> _stack {};
+    size_t _size { 0 };
+
+public:
+    constexpr FixedMinStack() = default;
+
+    /*
+     * Returns false, leaving the stack unchanged, if it's already full
+     */
+    constexpr auto push(const T& item) -> bool {
+        if (_size == Capacity) {
+            return false;
+        }
+        T min = _size == 0 ? item : std::min(item, _stack[_size - 1].second, Compare {});
+        _stack[_size++] = { item, std::move(min) };
+        return true;
+    }
+
+    [[nodiscard]] constexpr auto top() const -> std::optional<T> {
+        if (_size == 0) {
+            return {};
+        }
+        return _stack[_size - 1].first;
+    }
+
+    constexpr auto pop() -> void {
+        if (_size == 0) {
+            return;
+        }
+        // release whatever the element holds now rather than when it's overwritten
+        _stack[--_size] = {};
+    }
+
+    [[nodiscard]] constexpr auto getMin() const -> std::optional<T> {
+        if (_size == 0) {
+            return {};
+        }
+        return _stack[_size - 1].second;
+    }
+
+    [[nodiscard]] constexpr auto size() const noexcept -> size_t { return _size; }
+
+    [[nodiscard]] constexpr auto empty() const noexcept -> bool { return _size == 0; }
+
+    [[nodiscard]] constexpr auto full() const noexcept -> bool { return _size == Capacity; }
+
+    [[nodiscard]] static constexpr auto capacity() noexcept -> size_t { return Capacity; }
 };
@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <array>
+#include <deque>
 #include <optional>
+#include <random>
+#include <string>
 
 #include <gtest/gtest.h>
 
+#include "compact_min_stack.hpp"
 #include "min_stack.hpp"
+#include "sliding_window.hpp"
 
 TEST(MinStackTest, Simple) {
     MinStack<int> ms;
@@ -49,3 +56,202 @@ TEST(MinStackTest, FillConstructor) {
 
     ASSERT_EQ(ms.top(), std::nullopt);
 }
+
+auto makeStack(const std::vector<int>& nums) -> MinStack<int> { return MinStack<int> { nums.begin(), nums.end() }; }
+
+TEST(MinStackTest, Move) {
+    MinStack<int> ms = makeStack({ 4, 2, 7 });
+    ASSERT_EQ(ms.getMin(), 2);
+
+    MinStack<int> moved { std::move(ms) };
+    ASSERT_EQ(moved.size(), 3);
+    ASSERT_EQ(moved.top(), 7);
+    ASSERT_EQ(moved.getMin(), 2);
+}
+
+TEST(MinStackTest, InlineStorage) {
+    using Stack = MinStack<std::string, std::less<std::string>, 4>;
+    std::vector<std::string> words = { "pear", "fig", "plum", "apple", "kiwi", "date" };
+
+    Stack ms;
+    for (size_t i = 0; i < 4; ++i) {
+        ms.push(words[i]);
+    }
+    ASSERT_EQ(ms.memoryUsage(), 0);
+    ASSERT_EQ(ms.getMin(), "apple");
+
+    // moving an inline stack moves the elements themselves
+    Stack inlineMoved { std::move(ms) };
+    ASSERT_TRUE(ms.empty());
+    ASSERT_EQ(inlineMoved.size(), 4);
+    ASSERT_EQ(inlineMoved.top(), "apple");
+    ASSERT_EQ(inlineMoved.getMin(), "apple");
+
+    inlineMoved.push(words[4]);
+    inlineMoved.push(words[5]);
+    ASSERT_GT(inlineMoved.memoryUsage(), 0);
+    ASSERT_EQ(inlineMoved.top(), "date");
+    ASSERT_EQ(inlineMoved.getMin(), "apple");
+
+    // a spilled stack hands over its heap buffer
+    ms = std::move(inlineMoved);
+    ASSERT_TRUE(inlineMoved.empty());
+    ASSERT_EQ(inlineMoved.memoryUsage(), 0);
+    ASSERT_EQ(ms.size(), 6);
+
+    for (size_t i = words.size(); i-- > 0;) {
+        ASSERT_EQ(ms.top(), words[i]);
+        ASSERT_EQ(ms.getMin(), *std::min_element(words.begin(), words.begin() + static_cast<long>(i) + 1));
+        ms.pop();
+    }
+    ASSERT_EQ(ms.getMin(), std::nullopt);
+}
+
+constexpr auto fixedMins() -> std::array<int, 4> {
+    FixedMinStack<int, 3> ms;
+    ms.push(5);
+    ms.push(3);
+    ms.push(8);
+    bool overflowed = !ms.push(1);
+    std::array<int, 4> mins { ms.getMin().value(), 0, 0, overflowed };
+    ms.pop();
+    ms.pop();
+    mins[1] = ms.getMin().value();
+    ms.pop();
+    mins[2] = ms.getMin().value_or(-1);
+    return mins;
+}
+
+TEST(MinStackTest, FixedCapacity) {
+    static_assert(fixedMins() == std::array<int, 4> { 3, 5, -1, 1 });
+
+    FixedMinStack<std::string, 2> ms;
+    ASSERT_TRUE(ms.push("b"));
+    ASSERT_TRUE(ms.push("a"));
+    ASSERT_TRUE(ms.full());
+    ASSERT_FALSE(ms.push("c"));
+    ASSERT_EQ(ms.top(), "a");
+    ASSERT_EQ(ms.getMin(), "a");
+    ms.pop();
+    ASSERT_EQ(ms.getMin(), "b");
+}
+
+TEST(CompactMinStackTest, MatchesMinStack) {
+    std::mt19937 mt {};
+    mt.seed(4200);
+    // a small range, so equal minima are pushed and popped too
+    std::uniform_int_distribution<> dist { 0, 20 };
+
+    MinStack<int> expected;
+    CompactMinStack<int> ms;
+    ASSERT_EQ(ms.getMin(), std::nullopt);
+    for (int i = 0; i < 20000; ++i) {
+        if (dist(mt) < 12) {
+            int value = dist(mt);
+            expected.push(value);
+            ms.push(value);
+        } else {
+            expected.pop();
+            ms.pop();
+        }
+
+        ASSERT_EQ(ms.size(), expected.size());
+        ASSERT_EQ(ms.top(), expected.top());
+        ASSERT_EQ(ms.getMin(), expected.getMin());
+    }
+}
+
+TEST(CompactMinStackTest, StoresMinimaOnlyOnChange) {
+    std::vector<long> rising(10000);
+    std::ranges::generate(rising, [n = 0L]() mutable { return n++; });
+
+    MinStack<long> pairs { rising.begin(), rising.end() };
+    CompactMinStack<long> ms { rising.begin(), rising.end() };
+    ASSERT_EQ(ms.getMin(), 0);
+    ASSERT_LT(ms.memoryUsage(), pairs.memoryUsage() / 2 + 64);
+
+    for (size_t i = 1; i < rising.size(); ++i) {
+        ms.pop();
+    }
+    ASSERT_EQ(ms.top(), 0);
+    ASSERT_EQ(ms.getMin(), 0);
+    ms.pop();
+    ASSERT_TRUE(ms.empty());
+    ASSERT_EQ(ms.getMin(), std::nullopt);
+}
+
+struct Concat {
+    auto operator()(const std::string& a, const std::string& b) const -> std::string { return a + b; }
+};
+
+struct Min {
+    static inline size_t calls = 0;
+
+    auto operator()(int a, int b) const -> int {
+        ++calls;
+        return std::min(a, b);
+    }
+};
+
+template <typename Aggregator>
+void randomWindow(uint32_t seed) {
+    std::mt19937 mt {};
+    mt.seed(seed);
+    std::uniform_int_distribution<> dist { 0, 25 };
+
+    Aggregator window;
+    std::deque<std::string> reference;
+    ASSERT_EQ(window.query(), std::nullopt);
+    for (int i = 0; i < 5000; ++i) {
+        // drift between growing and shrinking so every window size shows up
+        bool grow = (i / 500) % 2 == 0 ? dist(mt) < 16 : dist(mt) < 10;
+        if (grow) {
+            std::string value(1, static_cast<char>('a' + dist(mt)));
+            window.push(value);
+            reference.push_back(value);
+        } else {
+            window.evict();
+            if (!reference.empty()) {
+                reference.pop_front();
+            }
+        }
+
+        ASSERT_EQ(window.size(), reference.size());
+        if (reference.empty()) {
+            ASSERT_EQ(window.query(), std::nullopt);
+            ASSERT_EQ(window.front(), std::nullopt);
+            continue;
+        }
+        std::string expected;
+        for (const auto& value : reference) {
+            expected += value;
+        }
+        ASSERT_EQ(window.query(), expected);
+        ASSERT_EQ(window.front(), reference.front());
+    }
+}
+
+TEST(SlidingWindowTest, TwoStacksInOrder) { randomWindow<SlidingWindowAggregator<std::string, Concat>>(4141); }
+
+TEST(SlidingWindowTest, DeamortizedInOrder) { randomWindow<DeamortizedWindowAggregator<std::string, Concat>>(4142); }
+
+TEST(SlidingWindowTest, DeamortizedConstantWork) {
+    DeamortizedWindowAggregator<int, Min> window;
+    std::mt19937 mt {};
+    mt.seed(4143);
+    std::uniform_int_distribution<> dist { 0, 1000 };
+
+    for (int i = 0; i < 100000; ++i) {
+        Min::calls = 0;
+        if (i < 50000 || dist(mt) < 500) {
+            window.push(dist(mt));
+        } else {
+            window.evict();
+        }
+        ASSERT_LE(Min::calls, 3);
+
+        Min::calls = 0;
+        static_cast<void>(window.query());
+        ASSERT_LE(Min::calls, 2);
+    }
+}
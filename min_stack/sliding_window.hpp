@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/*
+ * FIFO window aggregate over any associative Op (min, max, sum, gcd, matrix product...).
+ * Op doesn't need an inverse or to be commutative: query() always combines the values
+ * from oldest to newest.
+ *
+ * Uses the two-stacks method: new values go on a back stack that only keeps a running
+ * aggregate, and evictions pop a front stack that stores, MinStack-style, each value
+ * next to the aggregate of itself and everything newer in the front stack. When the
+ * front stack runs out, the back stack is flipped onto it. Every operation is
+ * amortized O(1), but an eviction that flips costs O(W).
+ */
+template <typename T, typename Op>
+class SlidingWindowAggregator {
+    // top (back()) is the oldest value
+    std::vector<std::pair<T, T>> _front;
+    std::vector<T> _back;
+    std::optional<T> _backAgg;
+
+    auto flip() -> void {
+        while (!_back.empty()) {
+            T& value = _back.back();
+            T agg = _front.empty() ? value : Op {}(value, _front.back().second);
+            _front.emplace_back(std::move(value), std::move(agg));
+            _back.pop_back();
+        }
+        _backAgg.reset();
+    }
+
+public:
+    auto push(const T& value) -> void {
+        _backAgg = _backAgg.has_value() ? Op {}(*_backAgg, value) : value;
+        _back.push_back(value);
+    }
+
+    /*
+     * Remove the oldest value. Does nothing if the window is empty.
+     */
+    auto evict() -> void {
+        if (_front.empty()) {
+            flip();
+        }
+        if (!_front.empty()) {
+            _front.pop_back();
+        }
+    }
+
+    [[nodiscard]] auto front() const -> std::optional<T> {
+        if (!_front.empty()) {
+            return _front.back().first;
+        }
+        if (!_back.empty()) {
+            return _back.front();
+        }
+        return {};
+    }
+
+    /*
+     * Aggregate of the whole window, oldest to newest
+     */
+    [[nodiscard]] auto query() const -> std::optional<T> {
+        if (_front.empty()) {
+            return _backAgg;
+        }
+        if (!_backAgg.has_value()) {
+            return _front.back().second;
+        }
+        return Op {}(_front.back().second, *_backAgg);
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _front.size() + _back.size(); }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return size() == 0; }
+};
+
+/*
+ * Same interface as SlidingWindowAggregator, but every operation is worst-case O(1)
+ * (at most three Op calls for push and evict, and two for query), for latency sensitive
+ * callers.
+ *
+ * All values live in one deque, oldest first, split into a front section and a back
+ * section. Front entries store the aggregate from themselves to the end of the front
+ * section, and the back section only has a running aggregate. As soon as the back
+ * section outgrows the front, it's turned into front entries, but incrementally: every
+ * later operation computes the aggregate of one more former back entry (newest first)
+ * and folds the former back aggregate into one more old front entry. The back section
+ * was at most one longer than the front, so the conversion is finished before
+ * evictions reach it, and long before the new back section can outgrow the front.
+ */
+template <typename T, typename Op>
+class DeamortizedWindowAggregator {
+    struct Entry {
+        T value;
+        T agg;
+    };
+
+    std::deque<Entry> _entries;
+    // positions count every value ever pushed, so they survive evictions
+    size_t _first { 0 };
+    size_t _backStart { 0 };
+    std::optional<T> _backAgg;
+
+    // state of the conversion in progress: old front entries in [_fixNext, _fixEnd)
+    // still need _converted folded in, and former back entries in [_fixEnd, _accumNext)
+    // still need their aggregate computed
+    size_t _fixNext { 0 };
+    size_t _fixEnd { 0 };
+    size_t _accumNext { 0 };
+    std::optional<T> _converted;
+
+    [[nodiscard]] auto at(size_t pos) -> Entry& { return _entries[pos - _first]; }
+    [[nodiscard]] auto at(size_t pos) const -> const Entry& { return _entries[pos - _first]; }
+
+    [[nodiscard]] auto end() const noexcept -> size_t { return _first + _entries.size(); }
+
+    [[nodiscard]] auto converting() const noexcept -> bool { return _fixNext < _fixEnd || _accumNext > _fixEnd; }
+
+    auto step() -> void {
+        // old front entries that were evicted don't need fixing
+        _fixNext = std::max(_fixNext, _first);
+        if (!converting() && end() - _backStart > _backStart - _first) {
+            // the whole back section becomes part of the front
+            _fixNext = _first;
+            _fixEnd = _backStart;
+            _accumNext = end();
+            _converted = std::move(_backAgg);
+            _backAgg.reset();
+            _backStart = end();
+        }
+
+        if (_accumNext > _fixEnd) {
+            --_accumNext;
+            if (_accumNext + 1 < _backStart) {
+                at(_accumNext).agg = Op {}(at(_accumNext).value, at(_accumNext + 1).agg);
+            }
+        }
+        if (_fixNext < _fixEnd) {
+            at(_fixNext).agg = Op {}(at(_fixNext).agg, *_converted);
+            ++_fixNext;
+        }
+    }
+
+public:
+    auto push(const T& value) -> void {
+        _backAgg = _backAgg.has_value() ? Op {}(*_backAgg, value) : value;
+        _entries.push_back({ value, value });
+        step();
+    }
+
+    /*
+     * Remove the oldest value. Does nothing if the window is empty.
+     */
+    auto evict() -> void {
+        if (_entries.empty()) {
+            return;
+        }
+        // the front section is never empty while the back one isn't
+        _entries.pop_front();
+        ++_first;
+        step();
+    }
+
+    [[nodiscard]] auto front() const -> std::optional<T> {
+        if (_entries.empty()) {
+            return {};
+        }
+        return _entries.front().value;
+    }
+
+    /*
+     * Aggregate of the whole window, oldest to newest
+     */
+    [[nodiscard]] auto query() const -> std::optional<T> {
+        if (_first == _backStart) {
+            return _backAgg;
+        }
+
+        const T& oldest = at(_first).agg;
+        // an old front entry that hasn't had the converted section folded in yet
+        bool unfixed = _first >= _fixNext && _first < _fixEnd;
+        T frontAgg = unfixed ? Op {}(oldest, *_converted) : oldest;
+        if (!_backAgg.has_value()) {
+            return frontAgg;
+        }
+        return Op {}(frontAgg, *_backAgg);
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _entries.size(); }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return _entries.empty(); }
+};
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sliding_segment.hpp"
+#include "sliding_window.hpp"
+
+/*
+ * Not a test: streams values through a sliding window min, the way a rate limiter
+ * would, and times each window implementation.
+ * Usage: window_bench [value count]
+ */
+
+namespace {
+
+struct Min {
+    auto operator()(int a, int b) const -> int { return std::min(a, b); }
+};
+
+// rescanning a deque, which is what we do without an aggregator
+class DequeScan {
+    std::deque<int> _values;
+
+public:
+    void push(int value) { _values.push_back(value); }
+    void evict() { _values.pop_front(); }
+    [[nodiscard]] auto size() const -> size_t { return _values.size(); }
+    [[nodiscard]] auto query() const -> std::optional<int> { return *std::ranges::min_element(_values); }
+};
+
+// the segment tree is fixed size, so pushing past capacity is the eviction
+class SegmentWindow {
+    SlidingSegmentTree<int, int, Min, std::identity> _tree;
+    size_t _size { 0 };
+
+public:
+    explicit SegmentWindow(size_t window)
+        : _tree { window } {}
+    void push(int value) {
+        _tree.push(value);
+        ++_size;
+    }
+    void evict() { --_size; }
+    [[nodiscard]] auto size() const -> size_t { return _size; }
+    [[nodiscard]] auto query() const -> std::optional<int> { return _tree.window_query(); }
+};
+
+volatile int sink = 0;
+
+template <typename Window>
+void bench(const std::string& name, Window window, const std::vector<int>& values, size_t windowSize) {
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    Clock::duration worst {};
+    for (int value : values) {
+        auto stepStart = Clock::now();
+        window.push(value);
+        if (window.size() > windowSize) {
+            window.evict();
+        }
+        sink = window.query().value();
+        worst = std::max(worst, Clock::now() - stepStart);
+    }
+    double totalNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    std::cout << std::left << std::setw(16) << name << std::right << std::setw(10) << std::fixed
+              << std::setprecision(1) << totalNs / static_cast<double>(values.size()) << " ns/op" << std::setw(12)
+              << std::chrono::duration<double, std::micro>(worst).count() << " us worst\n";
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+
+    std::mt19937 mt { 42 };
+    std::uniform_int_distribution<int> dist;
+    std::vector<int> values(count);
+    std::ranges::generate(values, [&] { return dist(mt); });
+
+    for (size_t windowSize : { 64, 4096, 262'144 }) {
+        std::cout << count << " values, window of " << windowSize << "\n";
+        if (windowSize <= 4096) {
+            bench("deque scan", DequeScan {}, values, windowSize);
+        }
+        bench("segment tree", SegmentWindow { windowSize }, values, windowSize);
+        bench("two stacks", SlidingWindowAggregator<int, Min> {}, values, windowSize);
+        bench("deamortized", DeamortizedWindowAggregator<int, Min> {}, values, windowSize);
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,412 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Ordered multiset stored as a B-tree whose nodes are sized to NodeBytes, so a lookup
+ * touches about log_B(n) contiguous nodes instead of chasing one pointer per level.
+ * Exposes the same insert/deleteNode/search/size interface as RBTree.
+ *
+ * Unlike RBTree, the Key pointers returned by insert and search are only valid until
+ * the next modification of the tree, since keys move around inside and between nodes.
+ */
+template <typename T, typename Compare = std::less<T>, size_t NodeBytes = 256>
+class BTree {
+public:
+    struct Key {
+        T data {};
+    };
+
+private:
+    static constexpr size_t cacheLine = 64;
+
+    // counting every key below the target is branchless, and for keys of up to 32 bits
+    // the fixed trip count lets GCC vectorize it even at -O2
+    static constexpr bool linearSearch = std::is_arithmetic_v<T> && (std::is_same_v<Compare, std::less<T>> ||
+                                                                     std::is_same_v<Compare, std::less<>>);
+
+    // header of every node, padded to the alignment of T
+    static constexpr size_t headerBytes = std::max(sizeof(uint32_t), alignof(Key));
+    static constexpr size_t keyRoom = (NodeBytes - headerBytes) / sizeof(Key);
+    // keys per 16 byte vector; the linear scan covers whole vectors
+    static constexpr size_t lanes = linearSearch ? std::max<size_t>(1, 16 / sizeof(Key)) : 1;
+
+    // minimum degree: every node but the root holds between t - 1 and 2t - 1 keys
+    static constexpr size_t t = std::max<size_t>(2, (keyRoom / lanes * lanes + 1) / 2);
+    static constexpr size_t maxKeys = 2 * t - 1;
+    static constexpr size_t keySlots = (maxKeys + lanes - 1) / lanes * lanes;
+    static_assert(keySlots < UINT16_MAX, "NodeBytes is too large for the node's key count");
+
+    // counter as wide as a key (but able to count every slot), so the scan's compares
+    // and sums fit the same vector lanes
+    using Lane = std::conditional_t<sizeof(T) <= 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+
+    /*
+     * Nodes start on a cache line, so a leaf of NodeBytes spans exactly
+     * NodeBytes / 64 lines. Internal nodes add maxKeys + 1 child pointers after the
+     * keys: with int keys and the default 256 bytes that's 59 keys, a 256 byte leaf
+     * and a 768 byte internal node.
+     */
+    struct alignas(cacheLine) Node {
+        uint16_t count { 0 };
+        bool leaf { true };
+        Key keys[keySlots];
+    };
+
+    struct Internal : Node {
+        Node* children[maxKeys + 1] {};
+    };
+
+    Node* _root { nullptr };
+    size_t _size { 0 };
+
+    [[nodiscard]] static auto children(Node* node) noexcept -> Node** { return static_cast<Internal*>(node)->children; }
+
+    [[nodiscard]] static auto child(const Node* node, size_t index) noexcept -> Node* {
+        return static_cast<const Internal*>(node)->children[index];
+    }
+
+    [[nodiscard]] static auto createNode(bool leaf) -> Node* {
+        Node* node = leaf ? new Node() : new Internal();
+        node->leaf = leaf;
+        return node;
+    }
+
+    static void destroyNode(Node* node) noexcept {
+        if (node->leaf) {
+            delete node;
+        } else {
+            delete static_cast<Internal*>(node);
+        }
+    }
+
+    static void destroyTree(Node* node) noexcept {
+        if (node == nullptr) {
+            return;
+        }
+        if (!node->leaf) {
+            for (size_t i = 0; i <= node->count; ++i) {
+                destroyTree(child(node, i));
+            }
+        }
+        destroyNode(node);
+    }
+
+    /*
+     * Index of the first key in node that isn't less than val
+     */
+    [[nodiscard]] static auto lowerBound(const Node* node, const T& val) noexcept -> size_t {
+        if constexpr (linearSearch) {
+            // scan every slot, masking out the unused ones, so the trip count is fixed
+            Lane index { 0 };
+            Lane count { node->count };
+            for (Lane i = 0; i < keySlots; ++i) {
+                index += static_cast<Lane>((i < count) & (node->keys[i].data < val));
+            }
+            return index;
+        } else {
+            // branchless binary search: the answer is always in [first, first + len]
+            const Key* first = node->keys;
+            size_t len = node->count;
+            if (len == 0) {
+                return 0;
+            }
+            while (len > 1) {
+                size_t half = len / 2;
+                first = Compare {}(first[half - 1].data, val) ? first + half : first;
+                len -= half;
+            }
+            return (first - node->keys) + Compare {}(first->data, val);
+        }
+    }
+
+    [[nodiscard]] static auto matches(const Node* node, size_t index, const T& val) -> bool {
+        return index < node->count && !Compare {}(val, node->keys[index].data);
+    }
+
+    /*
+     * Split the full child at index in two, moving its median key up into parent
+     */
+    static void splitChild(Node* parent, size_t index) {
+        Node* full = child(parent, index);
+        Node* right = createNode(full->leaf);
+
+        std::move(full->keys + t, full->keys + maxKeys, right->keys);
+        if (!full->leaf) {
+            std::copy(children(full) + t, children(full) + maxKeys + 1, children(right));
+        }
+        right->count = t - 1;
+        full->count = t - 1;
+
+        std::move_backward(parent->keys + index, parent->keys + parent->count, parent->keys + parent->count + 1);
+        std::copy_backward(children(parent) + index + 1, children(parent) + parent->count + 1,
+                           children(parent) + parent->count + 2);
+        parent->keys[index] = std::move(full->keys[t - 1]);
+        children(parent)[index + 1] = right;
+        ++parent->count;
+    }
+
+    /*
+     * Merge the child at index + 1 and the separating key into the child at index
+     */
+    static void mergeChildren(Node* parent, size_t index) {
+        Node* left = child(parent, index);
+        Node* right = child(parent, index + 1);
+
+        left->keys[left->count] = std::move(parent->keys[index]);
+        std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+        if (!left->leaf) {
+            std::copy(children(right), children(right) + right->count + 1, children(left) + left->count + 1);
+        }
+        left->count += right->count + 1;
+
+        std::move(parent->keys + index + 1, parent->keys + parent->count, parent->keys + index);
+        std::copy(children(parent) + index + 2, children(parent) + parent->count + 1, children(parent) + index + 1);
+        --parent->count;
+        destroyNode(right);
+    }
+
+    static void borrowFromLeft(Node* parent, size_t index) {
+        Node* node = child(parent, index);
+        Node* sibling = child(parent, index - 1);
+
+        std::move_backward(node->keys, node->keys + node->count, node->keys + node->count + 1);
+        node->keys[0] = std::move(parent->keys[index - 1]);
+        if (!node->leaf) {
+            std::copy_backward(children(node), children(node) + node->count + 1, children(node) + node->count + 2);
+            children(node)[0] = child(sibling, sibling->count);
+        }
+        parent->keys[index - 1] = std::move(sibling->keys[sibling->count - 1]);
+        --sibling->count;
+        ++node->count;
+    }
+
+    static void borrowFromRight(Node* parent, size_t index) {
+        Node* node = child(parent, index);
+        Node* sibling = child(parent, index + 1);
+
+        node->keys[node->count] = std::move(parent->keys[index]);
+        if (!node->leaf) {
+            children(node)[node->count + 1] = child(sibling, 0);
+            std::copy(children(sibling) + 1, children(sibling) + sibling->count + 1, children(sibling));
+        }
+        parent->keys[index] = std::move(sibling->keys[0]);
+        std::move(sibling->keys + 1, sibling->keys + sibling->count, sibling->keys);
+        --sibling->count;
+        ++node->count;
+    }
+
+    /*
+     * Make sure the child at index has at least t keys before descending into it.
+     * Returns the index of the child that now covers the same range.
+     */
+    static auto fillChild(Node* parent, size_t index) -> size_t {
+        if (child(parent, index)->count >= t) {
+            return index;
+        }
+        if (index > 0 && child(parent, index - 1)->count >= t) {
+            borrowFromLeft(parent, index);
+            return index;
+        }
+        if (index < parent->count && child(parent, index + 1)->count >= t) {
+            borrowFromRight(parent, index);
+            return index;
+        }
+        if (index < parent->count) {
+            mergeChildren(parent, index);
+            return index;
+        }
+        mergeChildren(parent, index - 1);
+        return index - 1;
+    }
+
+    static auto checkInvariantHelper(const Node* node, size_t depth, std::optional<size_t>& leafDepth,
+                                     const T* lower, const T* upper, bool root) -> std::optional<size_t> {
+        if ((!root && node->count < t - 1) || node->count > maxKeys || (root && node->count == 0)) {
+            return {};
+        }
+        for (size_t i = 0; i < node->count; ++i) {
+            const T& key = node->keys[i].data;
+            if ((i > 0 && Compare {}(key, node->keys[i - 1].data)) || (lower && Compare {}(key, *lower)) ||
+                (upper && Compare {}(*upper, key))) {
+                return {};
+            }
+        }
+        if (node->leaf) {
+            if (leafDepth.has_value() && *leafDepth != depth) {
+                return {};
+            }
+            leafDepth = depth;
+            return node->count;
+        }
+
+        size_t count { node->count };
+        for (size_t i = 0; i <= node->count; ++i) {
+            const T* childLower = i == 0 ? lower : &node->keys[i - 1].data;
+            const T* childUpper = i == node->count ? upper : &node->keys[i].data;
+            auto childCount = checkInvariantHelper(child(node, i), depth + 1, leafDepth,
+                                                   childLower, childUpper, false);
+            if (!childCount) {
+                return {};
+            }
+            count += *childCount;
+        }
+        return count;
+    }
+
+public:
+    BTree() = default;
+
+    BTree(const BTree&) = delete;
+    auto operator=(const BTree&) -> BTree& = delete;
+
+    BTree(BTree&& tree) noexcept {
+        std::swap(_root, tree._root);
+        std::swap(_size, tree._size);
+    }
+
+    auto operator=(BTree&& tree) noexcept -> BTree& {
+        BTree moved { std::move(tree) };
+        std::swap(_root, moved._root);
+        std::swap(_size, moved._size);
+        return *this;
+    }
+
+    ~BTree() { destroyTree(_root); }
+
+    void clear() noexcept {
+        destroyTree(_root);
+        _root = nullptr;
+        _size = 0;
+    }
+
+    auto insert(T data) -> const Key* {
+        if (_root == nullptr) {
+            _root = createNode(true);
+        }
+        if (_root->count == maxKeys) {
+            Node* root = createNode(false);
+            children(root)[0] = _root;
+            _root = root;
+            splitChild(root, 0);
+        }
+
+        // split full nodes on the way down so there's always room to insert
+        Node* node = _root;
+        while (!node->leaf) {
+            size_t index = lowerBound(node, data);
+            if (child(node, index)->count == maxKeys) {
+                splitChild(node, index);
+                if (Compare {}(node->keys[index].data, data)) {
+                    ++index;
+                }
+            }
+            node = child(node, index);
+        }
+
+        size_t index = lowerBound(node, data);
+        std::move_backward(node->keys + index, node->keys + node->count, node->keys + node->count + 1);
+        node->keys[index].data = std::move(data);
+        ++node->count;
+        ++_size;
+        return &node->keys[index];
+    }
+
+    auto deleteNode(const T& data) -> bool {
+        if (_root == nullptr) {
+            return false;
+        }
+
+        // the key being deleted changes when it's replaced by its predecessor or successor
+        T target = data;
+        Node* node = _root;
+        bool deleted { false };
+        while (true) {
+            size_t index = lowerBound(node, target);
+            bool found = matches(node, index, target);
+
+            if (node->leaf) {
+                if (found) {
+                    std::move(node->keys + index + 1, node->keys + node->count, node->keys + index);
+                    --node->count;
+                    deleted = true;
+                }
+                break;
+            }
+
+            if (!found) {
+                node = child(node, fillChild(node, index));
+                continue;
+            }
+
+            Node* left = child(node, index);
+            Node* right = child(node, index + 1);
+            if (left->count >= t) {
+                Node* pred = left;
+                while (!pred->leaf) {
+                    pred = child(pred, pred->count);
+                }
+                target = pred->keys[pred->count - 1].data;
+                node->keys[index].data = target;
+                node = left;
+            } else if (right->count >= t) {
+                Node* succ = right;
+                while (!succ->leaf) {
+                    succ = child(succ, 0);
+                }
+                target = succ->keys[0].data;
+                node->keys[index].data = target;
+                node = right;
+            } else {
+                mergeChildren(node, index);
+                node = left;
+            }
+        }
+
+        if (_root->count == 0) {
+            Node* oldRoot = _root;
+            _root = _root->leaf ? nullptr : child(_root, 0);
+            destroyNode(oldRoot);
+        }
+        if (deleted) {
+            --_size;
+        }
+        return deleted;
+    }
+
+    [[nodiscard]] auto search(const T& val) const -> std::optional<const Key*> {
+        const Node* node = _root;
+        while (node != nullptr) {
+            size_t index = lowerBound(node, val);
+            if (matches(node, index, val)) {
+                return &node->keys[index];
+            }
+            if (node->leaf) {
+                break;
+            }
+            node = child(node, index);
+        }
+        return {};
+    }
+
+    auto checkInvariant() const -> bool {
+        if (_root == nullptr) {
+            return _size == 0;
+        }
+        std::optional<size_t> leafDepth;
+        auto count = checkInvariantHelper(_root, 0, leafDepth, nullptr, nullptr, true);
+        return count.has_value() && *count == _size;
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _size; }
+
+    /*
+     * Number of keys that fit in a single node
+     */
+    [[nodiscard]] static constexpr auto nodeCapacity() noexcept -> size_t { return maxKeys; }
+};
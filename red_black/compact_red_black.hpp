@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Red-black tree whose nodes live in one vector and refer to each other by 32 bit
+ * index instead of pointer. The color is packed into the top bit of the parent index,
+ * so an int key costs 16 bytes per node instead of 40. Erased slots are reused through
+ * a free list threaded through their left index.
+ *
+ * Since nodes can move when the vector grows, and erasing moves data between nodes, the
+ * Node pointers returned by insert and search are only valid until the next
+ * modification of the tree.
+ */
+template <typename T, typename Compare = std::less<T>>
+class CompactRBTree {
+    static constexpr uint32_t nil = 0x7FFF'FFFF;
+    static constexpr uint32_t redBit = 0x8000'0000;
+
+public:
+    struct Node {
+        T data {};
+
+        friend class CompactRBTree;
+
+    private:
+        uint32_t left { nil };
+        uint32_t right { nil };
+        // parent index, with the top bit set for red nodes
+        uint32_t parentColor { nil | redBit };
+    };
+
+private:
+    std::vector<Node> _nodes;
+    uint32_t _root { nil };
+    uint32_t _freeList { nil };
+    size_t _size { 0 };
+
+    [[nodiscard]] auto left(uint32_t node) const noexcept -> uint32_t { return _nodes[node].left; }
+    [[nodiscard]] auto right(uint32_t node) const noexcept -> uint32_t { return _nodes[node].right; }
+    [[nodiscard]] auto parent(uint32_t node) const noexcept -> uint32_t { return _nodes[node].parentColor & ~redBit; }
+
+    void setParent(uint32_t node, uint32_t parent) noexcept {
+        _nodes[node].parentColor = (_nodes[node].parentColor & redBit) | parent;
+    }
+
+    [[nodiscard]] auto isRed(uint32_t node) const noexcept -> bool {
+        return node != nil && (_nodes[node].parentColor & redBit) != 0;
+    }
+
+    void setRed(uint32_t node, bool red) noexcept {
+        _nodes[node].parentColor = (_nodes[node].parentColor & ~redBit) | (red ? redBit : 0);
+    }
+
+    // point whatever referenced oldChild (parent or root) at newChild
+    void replaceChild(uint32_t parentNode, uint32_t oldChild, uint32_t newChild) noexcept {
+        if (parentNode == nil) {
+            _root = newChild;
+        } else if (left(parentNode) == oldChild) {
+            _nodes[parentNode].left = newChild;
+        } else {
+            _nodes[parentNode].right = newChild;
+        }
+    }
+
+    auto createNode(T data) -> uint32_t {
+        if (_freeList != nil) {
+            uint32_t node = _freeList;
+            _freeList = _nodes[node].left;
+            _nodes[node] = Node {};
+            _nodes[node].data = std::move(data);
+            return node;
+        }
+        if (_nodes.size() >= nil) {
+            throw std::length_error("CompactRBTree can't hold more than 2^31 - 1 nodes");
+        }
+        _nodes.emplace_back().data = std::move(data);
+        return static_cast<uint32_t>(_nodes.size() - 1);
+    }
+
+    void destroyNode(uint32_t node) {
+        _nodes[node].data = T {};
+        _nodes[node].left = _freeList;
+        _freeList = node;
+    }
+
+    void rotateLeft(uint32_t node) {
+        uint32_t rightChild = right(node);
+        _nodes[node].right = left(rightChild);
+        if (left(rightChild) != nil) {
+            setParent(left(rightChild), node);
+        }
+        setParent(rightChild, parent(node));
+        replaceChild(parent(node), node, rightChild);
+        _nodes[rightChild].left = node;
+        setParent(node, rightChild);
+    }
+
+    void rotateRight(uint32_t node) {
+        uint32_t leftChild = left(node);
+        _nodes[node].left = right(leftChild);
+        if (right(leftChild) != nil) {
+            setParent(right(leftChild), node);
+        }
+        setParent(leftChild, parent(node));
+        replaceChild(parent(node), node, leftChild);
+        _nodes[leftChild].right = node;
+        setParent(node, leftChild);
+    }
+
+    void fixInsertion(uint32_t insert) {
+        while (isRed(parent(insert))) {
+            uint32_t parentNode = parent(insert);
+            uint32_t grandparent = parent(parentNode);
+            bool parentLeftChild = left(grandparent) == parentNode;
+            uint32_t uncle = parentLeftChild ? right(grandparent) : left(grandparent);
+
+            if (isRed(uncle)) {
+                setRed(parentNode, false);
+                setRed(uncle, false);
+                setRed(grandparent, true);
+                insert = grandparent;
+                continue;
+            }
+
+            // straighten the zig-zag so insert is on the outside
+            if (parentLeftChild && right(parentNode) == insert) {
+                rotateLeft(parentNode);
+                parentNode = insert;
+            } else if (!parentLeftChild && left(parentNode) == insert) {
+                rotateRight(parentNode);
+                parentNode = insert;
+            }
+
+            setRed(grandparent, true);
+            setRed(parentNode, false);
+            if (parentLeftChild) {
+                rotateRight(grandparent);
+            } else {
+                rotateLeft(grandparent);
+            }
+            break;
+        }
+        setRed(_root, false);
+    }
+
+    // rebalance around a black leaf that's about to be removed, then remove it
+    void fixDeletion(uint32_t nodeToDelete) {
+        uint32_t current = nodeToDelete;
+        uint32_t parentNode = parent(current);
+
+        while (parentNode != nil) {
+            bool leftChild = left(parentNode) == current;
+            uint32_t sibling = leftChild ? right(parentNode) : left(parentNode);
+
+            if (isRed(sibling)) {
+                setRed(sibling, false);
+                setRed(parentNode, true);
+                if (leftChild) {
+                    rotateLeft(parentNode);
+                } else {
+                    rotateRight(parentNode);
+                }
+                sibling = leftChild ? right(parentNode) : left(parentNode);
+            }
+
+            uint32_t closeChild = leftChild ? left(sibling) : right(sibling);
+            uint32_t farChild = leftChild ? right(sibling) : left(sibling);
+            if (isRed(closeChild) && !isRed(farChild)) {
+                if (leftChild) {
+                    rotateRight(sibling);
+                } else {
+                    rotateLeft(sibling);
+                }
+                setRed(sibling, true);
+                setRed(closeChild, false);
+                farChild = sibling;
+                sibling = closeChild;
+            }
+
+            if (isRed(farChild)) {
+                if (leftChild) {
+                    rotateLeft(parentNode);
+                } else {
+                    rotateRight(parentNode);
+                }
+                setRed(sibling, isRed(parentNode));
+                setRed(parentNode, false);
+                setRed(farChild, false);
+                break;
+            }
+
+            // both of the sibling's children are black
+            setRed(sibling, true);
+            if (isRed(parentNode)) {
+                setRed(parentNode, false);
+                break;
+            }
+            current = parentNode;
+            parentNode = parent(current);
+        }
+
+        replaceChild(parent(nodeToDelete), nodeToDelete, nil);
+        destroyNode(nodeToDelete);
+        if (_root != nil) {
+            setRed(_root, false);
+        }
+    }
+
+    [[nodiscard]] auto findNode(const T& val) const -> uint32_t {
+        uint32_t curr = _root;
+        while (curr != nil) {
+            if (Compare {}(val, _nodes[curr].data)) {
+                curr = left(curr);
+            } else if (Compare {}(_nodes[curr].data, val)) {
+                curr = right(curr);
+            } else {
+                return curr;
+            }
+        }
+        return nil;
+    }
+
+    // black count of every path if node's subtree is valid, otherwise nothing
+    auto checkInvariantHelper(uint32_t node, const T* lower, const T* upper, size_t& count, size_t depth) const
+      -> std::optional<int> {
+        if (node == nil) {
+            return 1;
+        }
+        // no valid tree is deeper than this, and it keeps a corrupt chain from
+        // recursing once per node
+        if (depth > 2 * static_cast<size_t>(std::bit_width(_size))) {
+            return {};
+        }
+        ++count;
+
+        const T& data = _nodes[node].data;
+        if ((lower && Compare {}(data, *lower)) || (upper && Compare {}(*upper, data))) {
+            return {};
+        }
+        for (uint32_t child : { left(node), right(node) }) {
+            if (child != nil && (parent(child) != node || (isRed(node) && isRed(child)))) {
+                return {};
+            }
+        }
+
+        auto lb = checkInvariantHelper(left(node), lower, &data, count, depth + 1);
+        auto rb = checkInvariantHelper(right(node), &data, upper, count, depth + 1);
+        if (!lb || !rb || *lb != *rb) {
+            return {};
+        }
+        return *lb + !isRed(node);
+    }
+
+public:
+    CompactRBTree() = default;
+
+    void reserve(size_t count) { _nodes.reserve(count); }
+
+    /*
+     * Drop every node at once. The storage is kept for reuse.
+     */
+    void clear() noexcept {
+        _nodes.clear();
+        _root = nil;
+        _freeList = nil;
+        _size = 0;
+    }
+
+    auto insert(T data) -> const Node* {
+        uint32_t insert = createNode(std::move(data));
+
+        uint32_t parentNode = nil;
+        bool leftChild { false };
+        for (uint32_t curr = _root; curr != nil; curr = leftChild ? left(curr) : right(curr)) {
+            parentNode = curr;
+            leftChild = Compare {}(_nodes[insert].data, _nodes[curr].data);
+        }
+
+        setParent(insert, parentNode);
+        if (parentNode == nil) {
+            _root = insert;
+        } else if (leftChild) {
+            _nodes[parentNode].left = insert;
+        } else {
+            _nodes[parentNode].right = insert;
+        }
+        ++_size;
+
+        fixInsertion(insert);
+        return &_nodes[insert];
+    }
+
+    auto deleteNode(const T& data) -> bool {
+        uint32_t node = findNode(data);
+        if (node == nil) {
+            return false;
+        }
+        --_size;
+
+        // swap in the inorder successor's data, so the node to remove has at most one child
+        if (left(node) != nil && right(node) != nil) {
+            uint32_t successor = right(node);
+            while (left(successor) != nil) {
+                successor = left(successor);
+            }
+            std::swap(_nodes[node].data, _nodes[successor].data);
+            node = successor;
+        }
+
+        uint32_t child = left(node) != nil ? left(node) : right(node);
+        if (child != nil) {
+            // node must be black with a single red child
+            setParent(child, parent(node));
+            replaceChild(parent(node), node, child);
+            setRed(child, false);
+            destroyNode(node);
+            return true;
+        }
+        if (node == _root || isRed(node)) {
+            replaceChild(parent(node), node, nil);
+            destroyNode(node);
+            return true;
+        }
+
+        fixDeletion(node);
+        return true;
+    }
+
+    [[nodiscard]] auto search(const T& val) const -> std::optional<const Node*> {
+        uint32_t node = findNode(val);
+        if (node == nil) {
+            return {};
+        }
+        return &_nodes[node];
+    }
+
+    /*
+     * Write the raw node storage to out. The tree is restored by deserialize without
+     * rebuilding it.
+     */
+    void serialize(std::ostream& out) const
+        requires std::is_trivially_copyable_v<T>
+    {
+        uint64_t header[] = { _root, _freeList, _size, _nodes.size() };
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(_nodes.data()), static_cast<std::streamsize>(_nodes.size() * sizeof(Node)));
+    }
+
+    /*
+     * Restore a tree written by serialize. The header and every node's links are
+     * checked against the node count, and nodes are read in bounded chunks, so a corrupt
+     * or truncated stream throws instead of indexing out of bounds or allocating
+     * whatever its header claims.
+     */
+    [[nodiscard]] static auto deserialize(std::istream& in) -> CompactRBTree
+        requires std::is_trivially_copyable_v<T>
+    {
+        uint64_t header[4] {};
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            throw std::runtime_error("Couldn't read the CompactRBTree header");
+        }
+        auto [root, freeList, size, nodes] = header;
+        auto isLink = [&](uint64_t index) { return index == nil || index < nodes; };
+        if (nodes >= nil || !isLink(root) || !isLink(freeList) || size > nodes) {
+            throw std::runtime_error("Invalid CompactRBTree header");
+        }
+
+        CompactRBTree tree {};
+        tree._root = static_cast<uint32_t>(root);
+        tree._freeList = static_cast<uint32_t>(freeList);
+        tree._size = size;
+
+        constexpr size_t chunkNodes = 4096;
+        while (tree._nodes.size() < nodes) {
+            size_t read = tree._nodes.size();
+            size_t count = std::min<size_t>(chunkNodes, nodes - read);
+            tree._nodes.resize(read + count);
+            if (!in.read(reinterpret_cast<char*>(tree._nodes.data() + read),
+                         static_cast<std::streamsize>(count * sizeof(Node)))) {
+                throw std::runtime_error("Couldn't read the CompactRBTree nodes");
+            }
+        }
+
+        for (const Node& node : tree._nodes) {
+            if (!isLink(node.left) || !isLink(node.right) || !isLink(node.parentColor & ~redBit)) {
+                throw std::runtime_error("Invalid CompactRBTree node link");
+            }
+        }
+
+        // every node is either in the tree or on the free list, exactly once, so
+        // neither can have a cycle
+        std::vector<bool> seen(nodes);
+        auto visit = [&](uint32_t node) {
+            if (seen[node]) {
+                throw std::runtime_error("CompactRBTree node is linked more than once");
+            }
+            seen[node] = true;
+        };
+        size_t freeNodes { 0 };
+        for (uint32_t node = tree._freeList; node != nil; node = tree.left(node)) {
+            visit(node);
+            ++freeNodes;
+        }
+        std::vector<uint32_t> pending;
+        if (tree._root != nil) {
+            pending.push_back(tree._root);
+        }
+        while (!pending.empty()) {
+            uint32_t node = pending.back();
+            pending.pop_back();
+            visit(node);
+            for (uint32_t child : { tree.left(node), tree.right(node) }) {
+                if (child != nil) {
+                    pending.push_back(child);
+                }
+            }
+        }
+        if (freeNodes + size != nodes || !tree.checkInvariant()) {
+            throw std::runtime_error("Invalid CompactRBTree structure");
+        }
+        return tree;
+    }
+
+    auto checkInvariant() const -> bool {
+        if (_root == nil) {
+            return _size == 0;
+        }
+        if (parent(_root) != nil || isRed(_root)) {
+            return false;
+        }
+        size_t count { 0 };
+        return checkInvariantHelper(_root, nullptr, nullptr, count, 1).has_value() && count == _size;
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _size; }
+
+    /*
+     * Bytes of node storage currently allocated
+     */
+    [[nodiscard]] auto memoryUsage() const noexcept -> size_t { return _nodes.capacity() * sizeof(Node); }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+
+#include "red_black.hpp"
+
+/*
+ * Half open interval [start, end)
+ */
+template <typename P>
+struct Interval {
+    P start {};
+    P end {};
+
+    auto operator==(const Interval&) const -> bool = default;
+};
+
+template <typename P>
+struct IntervalCompare {
+    auto operator()(const Interval<P>& lhs, const Interval<P>& rhs) const -> bool {
+        return lhs.start < rhs.start || (!(rhs.start < lhs.start) && lhs.end < rhs.end);
+    }
+};
+
+/*
+ * Largest end point in each subtree
+ */
+template <typename P>
+struct MaxEnd {
+    using value_type = P;
+
+    static auto compute(const Interval<P>& data, const P* left, const P* right) -> P {
+        P max = data.end;
+        if (left != nullptr) {
+            max = std::max(max, *left);
+        }
+        if (right != nullptr) {
+            max = std::max(max, *right);
+        }
+        return max;
+    }
+};
+
+/*
+ * Intervals ordered by start in an RBTree, with each node also storing the largest end
+ * point in its subtree. Any subtree whose largest end is at or before a query's start
+ * can't overlap it and is skipped, so queries don't scan the whole set.
+ */
+template <typename P, template <typename> class NodePool = SlabPool>
+class IntervalTree {
+    RBTree<Interval<P>, IntervalCompare<P>, NodePool, MaxEnd<P>> _tree;
+
+public:
+    auto insert(const Interval<P>& interval) -> void { _tree.insert(interval); }
+
+    auto insert(P start, P end) -> void { _tree.emplace(Interval<P> { std::move(start), std::move(end) }); }
+
+    auto erase(const Interval<P>& interval) -> bool { return _tree.deleteNode(interval); }
+
+    /*
+     * Call fn on every interval overlapping [start, end), ordered by start. Each result
+     * costs at most O(log n) to reach and nothing is allocated.
+     */
+    template <typename Fn>
+    void for_each_overlapping(const P& start, const P& end, Fn&& fn) const {
+        _tree.for_each_pruned([&](const P& maxEnd) { return !(start < maxEnd); },
+                              [&](const Interval<P>& interval) {
+                                  if (!(interval.start < end)) {
+                                      return false;
+                                  }
+                                  if (start < interval.end) {
+                                      fn(interval);
+                                  }
+                                  return true;
+                              });
+    }
+
+    /*
+     * Call fn on every interval containing point, ordered by start
+     */
+    template <typename Fn>
+    void for_each_containing(const P& point, Fn&& fn) const {
+        _tree.for_each_pruned([&](const P& maxEnd) { return !(point < maxEnd); },
+                              [&](const Interval<P>& interval) {
+                                  if (point < interval.start) {
+                                      return false;
+                                  }
+                                  if (point < interval.end) {
+                                      fn(interval);
+                                  }
+                                  return true;
+                              });
+    }
+
+    /*
+     * The overlapping interval with the smallest start, if there's any. O(log n)
+     */
+    [[nodiscard]] auto any_overlap(const P& start, const P& end) const -> std::optional<Interval<P>> {
+        std::optional<Interval<P>> found;
+        _tree.for_each_pruned([&](const P& maxEnd) { return !(start < maxEnd); },
+                              [&](const Interval<P>& interval) {
+                                  if (!(interval.start < end)) {
+                                      return false;
+                                  }
+                                  if (start < interval.end) {
+                                      found = interval;
+                                      return false;
+                                  }
+                                  return true;
+                              });
+        return found;
+    }
+
+    auto clear() noexcept -> void { _tree.clear(); }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _tree.size(); }
+
+    [[nodiscard]] auto checkInvariant() const -> bool { return _tree.checkInvariant(); }
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Node pools hand out raw, uninitialized storage for exactly one Node at a time.
+ * The tree is responsible for constructing and destroying the Node in that storage.
+ *
+ *  - allocate() -> Node*       storage for one node
+ *  - deallocate(Node*)         return storage of an already destroyed node
+ *  - merge(Pool&&)             take over every node owned by another pool
+ *  - share(const Pool&)        keep another pool's nodes alive, for trees that are
+ *                              split into several trees
+ *  - release()                 (optional) drop every node at once
+ */
+
+/*
+ * Allocates nodes out of contiguous slabs of NodesPerSlab nodes. Freed nodes are
+ * put on an intrusive free list and handed out again before a new slab is touched,
+ * and release() frees whole slabs instead of one node at a time.
+ *
+ * Slabs are reference counted so that several pools can share them after a split.
+ * A slab is only freed once every pool referencing it has released it. Both halves of
+ * a split hold every slab of the original tree, since finding the slabs each half
+ * actually uses would mean visiting all of its nodes; merge and share skip the slabs
+ * a pool already holds, so splitting and joining the same trees doesn't grow them.
+ */
+template <typename Node, size_t NodesPerSlab = 512>
+class SlabPool {
+    union Slot {
+        Slot* next;
+        alignas(Node) std::byte storage[sizeof(Node)];
+    };
+
+    std::vector<std::shared_ptr<Slot[]>> _slabs;
+    Slot* _freeList { nullptr };
+    Slot* _freeTail { nullptr };
+    // number of slots handed out from the newest slab
+    size_t _used { NodesPerSlab };
+
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    auto operator=(const SlabPool&) -> SlabPool& = delete;
+    SlabPool(SlabPool&&) noexcept = default;
+    auto operator=(SlabPool&&) noexcept -> SlabPool& = default;
+    ~SlabPool() = default;
+
+    [[nodiscard]] auto allocate() -> Node* {
+        if (_freeList != nullptr) {
+            Slot* slot = _freeList;
+            _freeList = slot->next;
+            if (_freeList == nullptr) {
+                _freeTail = nullptr;
+            }
+            return reinterpret_cast<Node*>(slot->storage);
+        }
+
+        if (_used == NodesPerSlab) {
+            _slabs.push_back(std::make_shared_for_overwrite<Slot[]>(NodesPerSlab));
+            _used = 0;
+        }
+        return reinterpret_cast<Node*>(_slabs.back()[_used++].storage);
+    }
+
+    auto deallocate(Node* node) noexcept -> void {
+        auto* slot = reinterpret_cast<Slot*>(node);
+        slot->next = _freeList;
+        _freeList = slot;
+        if (_freeTail == nullptr) {
+            _freeTail = slot;
+        }
+    }
+
+    // the other pool's slabs go in front, so the newest slab (and _used) stays ours
+    auto merge(SlabPool&& other) -> void {
+        addSlabs(other);
+        if (other._freeList != nullptr) {
+            other._freeTail->next = _freeList;
+            _freeList = other._freeList;
+            if (_freeTail == nullptr) {
+                _freeTail = other._freeTail;
+            }
+        }
+        other._slabs.clear();
+        other._freeList = nullptr;
+        other._freeTail = nullptr;
+        other._used = NodesPerSlab;
+    }
+
+    auto share(const SlabPool& other) -> void { addSlabs(other); }
+
+    auto release() noexcept -> void {
+        _slabs.clear();
+        _freeList = nullptr;
+        _freeTail = nullptr;
+        _used = NodesPerSlab;
+    }
+
+    [[nodiscard]] auto slabs() const noexcept -> size_t { return _slabs.size(); }
+
+private:
+    // put other's slabs that this pool doesn't hold yet in front of ours
+    auto addSlabs(const SlabPool& other) -> void {
+        std::unordered_set<const Slot*> held;
+        held.reserve(_slabs.size());
+        for (const auto& slab : _slabs) {
+            held.insert(slab.get());
+        }
+
+        std::vector<std::shared_ptr<Slot[]>> missing;
+        for (const auto& slab : other._slabs) {
+            if (!held.contains(slab.get())) {
+                missing.push_back(slab);
+            }
+        }
+        _slabs.insert(_slabs.begin(), std::make_move_iterator(missing.begin()), std::make_move_iterator(missing.end()));
+    }
+};
+
+/*
+ * One heap allocation per node
+ */
+template <typename Node>
+class HeapPool {
+public:
+    [[nodiscard]] auto allocate() -> Node* { return static_cast<Node*>(::operator new(sizeof(Node))); }
+
+    auto deallocate(Node* node) noexcept -> void { ::operator delete(node); }
+
+    auto merge(HeapPool&&) noexcept -> void {}
+
+    auto share(const HeapPool&) noexcept -> void {}
+};
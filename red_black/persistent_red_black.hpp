@@ -0,0 +1,374 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/*
+ * Left-leaning red-black tree with copy-on-write nodes. Copying the tree (or calling
+ * snapshot()) is O(1): both trees share every node, and the next insert or deleteNode
+ * copies only the O(log n) nodes on its path that are still referenced by another
+ * version. Nodes are reference counted and freed when the last version using them
+ * is gone.
+ *
+ * RBTree can't share nodes like this, since a node has a single parent pointer, so
+ * this tree keeps no parent pointers and rebalances on the way back up instead.
+ *
+ * A single tree isn't thread safe, but the reference counts are atomic and shared nodes
+ * are never modified, so different versions can be read and written from different
+ * threads.
+ */
+template <typename T, typename Compare = std::less<T>>
+class PersistentRBTree {
+public:
+    struct Node {
+        T data {};
+
+        friend class PersistentRBTree;
+
+    private:
+        Node* left { nullptr };
+        Node* right { nullptr };
+        std::atomic<uint32_t> refs { 1 };
+        bool red { true };
+
+        explicit Node(T value)
+            : data { std::move(value) } {}
+    };
+
+private:
+    Node* _root { nullptr };
+    size_t _size { 0 };
+
+    static void retain(Node* node) noexcept {
+        if (node != nullptr) {
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void release(Node* node) noexcept {
+        if (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release(node->left);
+            release(node->right);
+            delete node;
+        }
+    }
+
+    /*
+     * Make node safe to modify. Nodes referenced by another version are copied, and the
+     * copy takes a reference on both children, so they get copied too if they're touched.
+     */
+    static auto own(Node* node) -> Node* {
+        if (node->refs.load(std::memory_order_acquire) == 1) {
+            return node;
+        }
+        Node* copy = new Node(node->data);
+        copy->left = node->left;
+        copy->right = node->right;
+        copy->red = node->red;
+        retain(copy->left);
+        retain(copy->right);
+        release(node);
+        return copy;
+    }
+
+    static auto isRed(const Node* node) noexcept -> bool { return node != nullptr && node->red; }
+
+    // every helper below takes a node it owns and returns the owned root of the subtree
+
+    static auto rotateLeft(Node* node) -> Node* {
+        Node* right = own(node->right);
+        node->right = right->left;
+        right->left = node;
+        right->red = node->red;
+        node->red = true;
+        return right;
+    }
+
+    static auto rotateRight(Node* node) -> Node* {
+        Node* left = own(node->left);
+        node->left = left->right;
+        left->right = node;
+        left->red = node->red;
+        node->red = true;
+        return left;
+    }
+
+    static void flipColors(Node* node) {
+        node->left = own(node->left);
+        node->right = own(node->right);
+        node->red = !node->red;
+        node->left->red = !node->left->red;
+        node->right->red = !node->right->red;
+    }
+
+    static auto fixUp(Node* node) -> Node* {
+        if (isRed(node->right) && !isRed(node->left)) {
+            node = rotateLeft(node);
+        }
+        if (isRed(node->left) && isRed(node->left->left)) {
+            node = rotateRight(node);
+        }
+        if (isRed(node->left) && isRed(node->right)) {
+            flipColors(node);
+        }
+        return node;
+    }
+
+    static auto moveRedLeft(Node* node) -> Node* {
+        flipColors(node);
+        if (isRed(node->right->left)) {
+            node->right = rotateRight(own(node->right));
+            node = rotateLeft(node);
+            flipColors(node);
+        }
+        return node;
+    }
+
+    static auto moveRedRight(Node* node) -> Node* {
+        flipColors(node);
+        if (isRed(node->left->left)) {
+            node = rotateRight(node);
+            flipColors(node);
+        }
+        return node;
+    }
+
+    static auto insertHelper(Node* node, T& data) -> Node* {
+        if (node == nullptr) {
+            return new Node(std::move(data));
+        }
+        node = own(node);
+        if (Compare {}(data, node->data)) {
+            node->left = insertHelper(node->left, data);
+        } else {
+            node->right = insertHelper(node->right, data);
+        }
+        return fixUp(node);
+    }
+
+    static auto deleteMin(Node* node) -> Node* {
+        if (node->left == nullptr) {
+            release(node);
+            return nullptr;
+        }
+        if (!isRed(node->left) && !isRed(node->left->left)) {
+            node = moveRedLeft(node);
+        }
+        node->left = deleteMin(own(node->left));
+        return fixUp(node);
+    }
+
+    // val must be in the subtree
+    static auto deleteHelper(Node* node, const T& val) -> Node* {
+        if (Compare {}(val, node->data)) {
+            if (!isRed(node->left) && !isRed(node->left->left)) {
+                node = moveRedLeft(node);
+            }
+            node->left = deleteHelper(own(node->left), val);
+            return fixUp(node);
+        }
+
+        if (isRed(node->left)) {
+            node = rotateRight(node);
+        }
+        if (!Compare {}(node->data, val) && node->right == nullptr) {
+            release(node);
+            return nullptr;
+        }
+        // a rotation moves val's node to the right; with duplicates the node that
+        // replaces it can still compare equal, so it mustn't be taken for the match
+        bool rotated { false };
+        if (!isRed(node->right) && !isRed(node->right->left)) {
+            Node* moved = moveRedRight(node);
+            rotated = moved != node;
+            node = moved;
+        }
+        if (!rotated && !Compare {}(node->data, val)) {
+            const Node* successor = node->right;
+            while (successor->left != nullptr) {
+                successor = successor->left;
+            }
+            node->data = successor->data;
+            node->right = deleteMin(own(node->right));
+        } else {
+            node->right = deleteHelper(own(node->right), val);
+        }
+        return fixUp(node);
+    }
+
+    [[nodiscard]] auto findNode(const T& val) const -> const Node* {
+        const Node* curr = _root;
+        while (curr != nullptr) {
+            if (Compare {}(val, curr->data)) {
+                curr = curr->left;
+            } else if (Compare {}(curr->data, val)) {
+                curr = curr->right;
+            } else {
+                return curr;
+            }
+        }
+        return nullptr;
+    }
+
+    // black count of every path if node's subtree is valid, otherwise nothing
+    static auto checkInvariantHelper(const Node* node, const T* lower, const T* upper, size_t& count)
+      -> std::optional<int> {
+        if (node == nullptr) {
+            return 1;
+        }
+        ++count;
+
+        if ((lower && Compare {}(node->data, *lower)) || (upper && Compare {}(*upper, node->data))) {
+            return {};
+        }
+        // left-leaning: a red node is always a left child
+        if (isRed(node->right) || (isRed(node) && isRed(node->left))) {
+            return {};
+        }
+
+        auto lb = checkInvariantHelper(node->left, lower, &node->data, count);
+        auto rb = checkInvariantHelper(node->right, &node->data, upper, count);
+        if (!lb || !rb || *lb != *rb) {
+            return {};
+        }
+        return *lb + !node->red;
+    }
+
+public:
+    /*
+     * Forward iterator in sorted order. It keeps the path to the current node, since
+     * there are no parent pointers, and is valid as long as the version it came from.
+     */
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = T;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        Iterator() = default;
+
+        auto operator*() const -> reference { return _path.back()->data; }
+        auto operator->() const -> pointer { return &_path.back()->data; }
+
+        auto operator++() -> Iterator& {
+            const Node* node = _path.back();
+            _path.pop_back();
+            pushLeftSpine(node->right);
+            return *this;
+        }
+
+        auto operator++(int) -> Iterator {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        friend auto operator==(const Iterator& a, const Iterator& b) -> bool {
+            return a._path.empty() ? b._path.empty() : !b._path.empty() && a._path.back() == b._path.back();
+        }
+
+    private:
+        std::vector<const Node*> _path;
+
+        explicit Iterator(const Node* root) { pushLeftSpine(root); }
+
+        void pushLeftSpine(const Node* node) {
+            for (; node != nullptr; node = node->left) {
+                _path.push_back(node);
+            }
+        }
+
+        friend class PersistentRBTree;
+    };
+
+    PersistentRBTree() = default;
+
+    PersistentRBTree(const PersistentRBTree& tree) noexcept
+        : _root { tree._root }
+        , _size { tree._size } {
+        retain(_root);
+    }
+
+    PersistentRBTree(PersistentRBTree&& tree) noexcept { swap(tree); }
+
+    auto operator=(const PersistentRBTree& tree) noexcept -> PersistentRBTree& {
+        PersistentRBTree copy { tree };
+        swap(copy);
+        return *this;
+    }
+
+    auto operator=(PersistentRBTree&& tree) noexcept -> PersistentRBTree& {
+        PersistentRBTree moved { std::move(tree) };
+        swap(moved);
+        return *this;
+    }
+
+    ~PersistentRBTree() { release(_root); }
+
+    void swap(PersistentRBTree& tree) noexcept {
+        std::swap(_root, tree._root);
+        std::swap(_size, tree._size);
+    }
+
+    /*
+     * O(1) read-only view of the current version. Later changes to this tree don't
+     * affect it.
+     */
+    [[nodiscard]] auto snapshot() const noexcept -> PersistentRBTree { return *this; }
+
+    void clear() noexcept {
+        release(_root);
+        _root = nullptr;
+        _size = 0;
+    }
+
+    void insert(T data) {
+        _root = insertHelper(_root, data);
+        _root->red = false;
+        ++_size;
+    }
+
+    auto deleteNode(const T& data) -> bool {
+        if (findNode(data) == nullptr) {
+            return false;
+        }
+        _root = own(_root);
+        if (!isRed(_root->left) && !isRed(_root->right)) {
+            _root->red = true;
+        }
+        _root = deleteHelper(_root, data);
+        if (_root != nullptr) {
+            _root->red = false;
+        }
+        --_size;
+        return true;
+    }
+
+    [[nodiscard]] auto search(const T& val) const -> std::optional<const Node*> {
+        const Node* node = findNode(val);
+        if (node == nullptr) {
+            return {};
+        }
+        return node;
+    }
+
+    [[nodiscard]] auto begin() const -> Iterator { return Iterator { _root }; }
+    [[nodiscard]] auto end() const -> Iterator { return Iterator {}; }
+
+    auto checkInvariant() const -> bool {
+        if (isRed(_root)) {
+            return false;
+        }
+        size_t count { 0 };
+        return checkInvariantHelper(_root, nullptr, nullptr, count).has_value() && count == _size;
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _size; }
+};
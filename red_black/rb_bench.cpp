@@ -0,0 +1,276 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "btree.hpp"
+#include "compact_red_black.hpp"
+#include "red_black.hpp"
+#include "sharded_red_black.hpp"
+
+/*
+ * Not a test: times the ordered containers against each other.
+ * Usage: rb_bench [element count]
+ */
+
+namespace {
+
+template <typename Fn>
+auto timeMs(Fn&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const std::string& container, const std::string& operation, double ms, size_t ops) {
+    std::cout << std::left << std::setw(16) << container << std::setw(12) << operation << std::right << std::setw(10)
+              << std::fixed << std::setprecision(1) << ms << " ms" << std::setw(10) << std::setprecision(1)
+              << ms * 1e6 / static_cast<double>(ops) << " ns/op\n";
+}
+
+// keeps the optimizer from throwing away lookups
+volatile size_t sink = 0;
+
+template <typename Tree>
+void benchTree(const std::string& name, const std::vector<int>& keys, const std::vector<int>& probes) {
+    Tree tree {};
+    report(name, "insert", timeMs([&] {
+               for (int key : keys) {
+                   tree.insert(key);
+               }
+           }),
+           keys.size());
+
+    report(name, "search", timeMs([&] {
+               size_t found { 0 };
+               for (int probe : probes) {
+                   found += tree.search(probe).has_value();
+               }
+               sink = found;
+           }),
+           probes.size());
+
+    report(name, "delete", timeMs([&] {
+               for (int key : keys) {
+                   tree.deleteNode(key);
+               }
+           }),
+           keys.size());
+}
+
+void benchSet(const std::vector<int>& keys, const std::vector<int>& probes) {
+    std::multiset<int> set;
+    report("std::set", "insert", timeMs([&] {
+               for (int key : keys) {
+                   set.insert(key);
+               }
+           }),
+           keys.size());
+
+    report("std::set", "search", timeMs([&] {
+               size_t found { 0 };
+               for (int probe : probes) {
+                   found += set.contains(probe);
+               }
+               sink = found;
+           }),
+           probes.size());
+
+    report("std::set", "delete", timeMs([&] {
+               for (int key : keys) {
+                   auto it = set.find(key);
+                   if (it != set.end()) {
+                       set.erase(it);
+                   }
+               }
+           }),
+           keys.size());
+}
+
+// point lookups one at a time against interleaved groups of lookups
+void benchSearchMany(const std::vector<int>& keys, const std::vector<int>& probes) {
+    RBTree<int> tree {};
+    for (int key : keys) {
+        tree.insert(key);
+    }
+    std::vector<RBTree<int>::Node*> out(probes.size());
+
+    auto countFound = [&] { sink = static_cast<size_t>(std::ranges::count(out, nullptr)); };
+    report("RBTree", "search", timeMs([&] {
+               for (size_t i = 0; i < probes.size(); ++i) {
+                   out[i] = tree.search(probes[i]).value_or(nullptr);
+               }
+               countFound();
+           }),
+           probes.size());
+    report("RBTree/4", "search_many", timeMs([&] {
+               tree.search_many<4>(probes, out);
+               countFound();
+           }),
+           probes.size());
+    report("RBTree/8", "search_many", timeMs([&] {
+               tree.search_many<8>(probes, out);
+               countFound();
+           }),
+           probes.size());
+    report("RBTree/16", "search_many", timeMs([&] {
+               tree.search_many<16>(probes, out);
+               countFound();
+           }),
+           probes.size());
+    report("RBTree/32", "search_many", timeMs([&] {
+               tree.search_many<32>(probes, out);
+               countFound();
+           }),
+           probes.size());
+}
+
+// the usual way of sharing a tree: one lock around everything
+struct LockedTree {
+    std::mutex mutex;
+    RBTree<int> tree;
+
+    void insert(int key) {
+        std::lock_guard lock { mutex };
+        tree.insert(key);
+    }
+
+    auto deleteNode(int key) -> bool {
+        std::lock_guard lock { mutex };
+        return tree.deleteNode(key);
+    }
+
+    auto contains(int key) -> bool {
+        std::lock_guard lock { mutex };
+        return tree.search(key).has_value();
+    }
+};
+
+// 90% lookups, 5% inserts and 5% deletes, split evenly over the threads
+template <typename Set>
+void benchMixed(const std::string& name, Set& set, const std::vector<int>& probes, size_t threads) {
+    size_t perThread = probes.size() / threads;
+    std::vector<size_t> found(threads);
+    report(name + "/" + std::to_string(threads), "mixed", timeMs([&] {
+               std::vector<std::thread> workers;
+               for (size_t t = 0; t < threads; ++t) {
+                   workers.emplace_back([&, t] {
+                       for (size_t i = t * perThread; i < (t + 1) * perThread; ++i) {
+                           switch (i % 20) {
+                           case 0:
+                               set.insert(probes[i]);
+                               break;
+                           case 1:
+                               set.deleteNode(probes[i]);
+                               break;
+                           default:
+                               found[t] += set.contains(probes[i]);
+                           }
+                       }
+                   });
+               }
+               for (auto& worker : workers) {
+                   worker.join();
+               }
+           }),
+           perThread * threads);
+    sink = std::reduce(found.begin(), found.end());
+}
+
+void benchConcurrent(const std::vector<int>& keys, const std::vector<int>& probes) {
+    for (size_t threads : { 1, 2, 4, 8, 16 }) {
+        LockedTree locked {};
+        for (int key : keys) {
+            locked.tree.insert(key);
+        }
+        benchMixed("locked", locked, probes, threads);
+
+        auto sharded = ShardedRBTree<int>::from_sample(std::span { keys }.first(std::min<size_t>(keys.size(), 10'000)), 64);
+        for (int key : keys) {
+            sharded.insert(key);
+        }
+        benchMixed("sharded", sharded, probes, threads);
+    }
+}
+
+// applies the keys in batches to a tree that already holds every even key
+void benchBatches(const std::vector<int>& keys, size_t batchSize) {
+    std::vector<int> even(keys.size());
+    for (size_t i = 0; i < even.size(); ++i) {
+        even[i] = static_cast<int>(2 * i);
+    }
+    std::vector<int> odd(keys.size());
+    std::ranges::transform(keys, odd.begin(), [](int key) { return 2 * key + 1; });
+
+    std::string name = "RBTree/" + std::to_string(batchSize);
+    auto perKey = RBTree<int>::from_sorted(even);
+    auto batched = RBTree<int>::from_sorted(even);
+    auto forEachBatch = [&](auto fn) {
+        for (size_t i = 0; i < odd.size(); i += batchSize) {
+            fn(std::span { odd }.subspan(i, std::min(batchSize, odd.size() - i)));
+        }
+    };
+
+    report(name, "insert", timeMs([&] {
+               forEachBatch([&](auto batch) {
+                   for (int key : batch) {
+                       perKey.insert(key);
+                   }
+               });
+           }),
+           odd.size());
+    report(name, "ins_batch", timeMs([&] { forEachBatch([&](auto batch) { batched.insert_batch(batch); }); }),
+           odd.size());
+    report(name, "delete", timeMs([&] {
+               forEachBatch([&](auto batch) {
+                   for (int key : batch) {
+                       perKey.deleteNode(key);
+                   }
+               });
+           }),
+           odd.size());
+    report(name, "del_batch", timeMs([&] { forEachBatch([&](auto batch) { sink = batched.erase_batch(batch); }); }),
+           odd.size());
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+
+    std::mt19937 mt { 42 };
+    std::vector<int> keys(count);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::ranges::shuffle(keys, mt);
+
+    std::vector<int> probes(count);
+    std::uniform_int_distribution<int> probeDist { 0, static_cast<int>(2 * count) };
+    std::ranges::generate(probes, [&] { return probeDist(mt); });
+
+    std::cout << count << " random keys\n";
+    benchTree<RBTree<int>>("RBTree", keys, probes);
+    benchTree<CompactRBTree<int>>("CompactRBTree", keys, probes);
+    benchTree<BTree<int>>("BTree", keys, probes);
+    benchSet(keys, probes);
+
+    std::cout << "\n" << count << " lookups, one at a time and in groups\n";
+    benchSearchMany(keys, probes);
+
+    std::cout << "\n" << count << " mixed operations from several threads, on " << std::thread::hardware_concurrency()
+              << " cores\n";
+    benchConcurrent(keys, probes);
+
+    std::cout << "\n" << count << " keys inserted into and deleted from a tree of " << count << " keys\n";
+    for (size_t batchSize : { 1'000, 10'000, 100'000, 1'000'000 }) {
+        benchBatches(keys, batchSize);
+    }
+    return 0;
+}
@@ -1,9 +1,26 @@
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <map>
 #include <optional>
 #include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "btree.hpp"
+#include "compact_red_black.hpp"
+#include "interval_tree.hpp"
+#include "persistent_red_black.hpp"
 #include "red_black.hpp"
+#include "sharded_red_black.hpp"
+#include "sliding_quantile.hpp"
 
 TEST(RedBlackTest, InsertSimple) {
     RBTree<int> tree {};
@@ -127,3 +144,1164 @@ TEST(RedBlackTest, RandomInsertAndDeleteInvariantLarge) {
         ASSERT_TRUE(tree.checkInvariant());
     }
 }
+
+TEST(RedBlackTest, ClearAndReuse) {
+    std::mt19937 mt {};
+    mt.seed(77);
+    std::uniform_int_distribution<> dist { -1000, 1000 };
+
+    RBTree<int> tree {};
+    for (int round = 0; round < 3; ++round) {
+        for (uint32_t i = 0; i < 2000; ++i) {
+            tree.insert(dist(mt));
+        }
+        ASSERT_EQ(tree.size(), 2000);
+        ASSERT_TRUE(tree.checkInvariant());
+
+        tree.clear();
+        ASSERT_EQ(tree.size(), 0);
+        ASSERT_EQ(tree.search(dist(mt)), std::nullopt);
+    }
+
+    tree.insert(5);
+    ASSERT_EQ(tree.search(5).value()->data, 5);
+}
+
+TEST(RedBlackTest, HeapPoolInsertDelete) {
+    std::mt19937 mt {};
+    mt.seed(91);
+    std::uniform_int_distribution<> dist { -100, 100 };
+
+    RBTree<int, std::less<int>, HeapPool> tree {};
+    for (uint32_t i = 0; i < 1000; ++i) {
+        int num = dist(mt);
+        if (dist(mt) <= 0) {
+            tree.insert(num);
+        } else {
+            tree.deleteNode(num);
+        }
+        ASSERT_TRUE(tree.checkInvariant());
+    }
+    tree.clear();
+    ASSERT_EQ(tree.size(), 0);
+}
+
+TEST(RedBlackTest, NonTrivialDataMove) {
+    RBTree<std::string> tree {};
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(std::string(32, static_cast<char>('a' + i % 26)) + std::to_string(i));
+    }
+    ASSERT_TRUE(tree.deleteNode(std::string(32, 'a') + "0"));
+    ASSERT_EQ(tree.size(), 99);
+
+    RBTree<std::string> moved { std::move(tree) };
+    ASSERT_EQ(moved.size(), 99);
+    ASSERT_EQ(tree.size(), 0);
+    ASSERT_NE(moved.search(std::string(32, 'b') + "1"), std::nullopt);
+
+    moved.clear();
+    ASSERT_EQ(moved.search(std::string(32, 'b') + "1"), std::nullopt);
+}
+
+TEST(RedBlackTest, DeepCopy) {
+    OrderStatisticTree<int> tree {};
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert((i * 7919) % 1000);
+    }
+
+    OrderStatisticTree<int> copy { tree };
+    ASSERT_TRUE(copy.checkInvariant());
+    ASSERT_TRUE(std::ranges::equal(tree, copy));
+    ASSERT_EQ(copy.select(500).value()->data, 500);
+
+    // the copy is independent of the original
+    for (int i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE(tree.deleteNode(i));
+    }
+    ASSERT_EQ(copy.size(), 1000);
+    ASSERT_TRUE(copy.checkInvariant());
+    ASSERT_NE(copy.search(0), std::nullopt);
+
+    copy = tree;
+    ASSERT_TRUE(std::ranges::equal(tree, copy));
+    ASSERT_EQ(copy.rank(501), 250);
+
+    OrderStatisticTree<int> moved {};
+    moved = std::move(copy);
+    ASSERT_EQ(moved.size(), 500);
+    ASSERT_EQ(copy.size(), 0);
+    ASSERT_TRUE(moved.checkInvariant());
+}
+
+TEST(OrderStatisticTest, SelectRankSimple) {
+    OrderStatisticTree<int> tree {};
+    ASSERT_EQ(tree.select(0), std::nullopt);
+    ASSERT_EQ(tree.rank(10), 0);
+
+    for (int num : { 50, 20, 70, 10, 30, 60, 80, 30 }) {
+        tree.insert(num);
+    }
+
+    std::vector<int> sorted = { 10, 20, 30, 30, 50, 60, 70, 80 };
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        ASSERT_EQ(tree.select(i).value()->data, sorted[i]);
+    }
+    ASSERT_EQ(tree.select(sorted.size()), std::nullopt);
+
+    ASSERT_EQ(tree.rank(5), 0);
+    ASSERT_EQ(tree.rank(10), 0);
+    ASSERT_EQ(tree.rank(30), 2);
+    ASSERT_EQ(tree.rank(31), 4);
+    ASSERT_EQ(tree.rank(100), 8);
+}
+
+TEST(OrderStatisticTest, RandomInsertDeleteSelectRank) {
+    std::mt19937 mt {};
+    mt.seed(2024);
+    std::uniform_int_distribution<> dist { -200, 200 };
+
+    OrderStatisticTree<int> tree {};
+    std::vector<int> sorted;
+    for (uint32_t i = 0; i < 3000; ++i) {
+        int num = dist(mt);
+        if (dist(mt) <= 50) {
+            tree.insert(num);
+            sorted.insert(std::ranges::upper_bound(sorted, num), num);
+        } else {
+            auto it = std::ranges::lower_bound(sorted, num);
+            bool exists = it != sorted.end() && *it == num;
+            ASSERT_EQ(tree.deleteNode(num), exists);
+            if (exists) {
+                sorted.erase(it);
+            }
+        }
+        ASSERT_TRUE(tree.checkInvariant());
+        ASSERT_EQ(tree.size(), sorted.size());
+
+        int probe = dist(mt);
+        ASSERT_EQ(tree.rank(probe), std::ranges::lower_bound(sorted, probe) - sorted.begin());
+        if (!sorted.empty()) {
+            size_t k = static_cast<size_t>(dist(mt) + 200) % sorted.size();
+            ASSERT_EQ(tree.select(k).value()->data, sorted[k]);
+        }
+    }
+}
+
+TEST(RedBlackTest, SearchMany) {
+    std::mt19937 mt {};
+    mt.seed(3838);
+    std::uniform_int_distribution<> dist { -3000, 3000 };
+
+    RBTree<int> tree {};
+    std::vector<int> keys;
+    std::vector<RBTree<int>::Node*> out(1);
+    tree.search_many(keys, out);
+    keys.push_back(1);
+    tree.search_many(keys, out);
+    ASSERT_EQ(out[0], nullptr);
+
+    for (int i = 0; i < 2000; ++i) {
+        tree.insert(dist(mt));
+    }
+    keys.clear();
+    for (int i = 0; i < 1000; ++i) {
+        keys.push_back(dist(mt));
+    }
+
+    auto check = [&](auto searchMany) {
+        std::vector<RBTree<int>::Node*> found(keys.size(), nullptr);
+        searchMany(found);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            auto expected = tree.search(keys[i]);
+            ASSERT_EQ(found[i] != nullptr, expected.has_value());
+            if (found[i] != nullptr) {
+                ASSERT_EQ(found[i]->data, keys[i]);
+            }
+        }
+    };
+    check([&](auto& found) { tree.search_many(keys, found); });
+    check([&](auto& found) { tree.search_many<1>(keys, found); });
+    check([&](auto& found) { tree.search_many<3>(keys, found); });
+    check([&](auto& found) { tree.search_many<64>(keys, found); });
+}
+
+TEST(SlidingQuantileTest, Simple) {
+    SlidingQuantile<int> window { 4 };
+    ASSERT_EQ(window.median(), std::nullopt);
+
+    for (int sample : { 5, 1, 4 }) {
+        window.push(sample);
+    }
+    ASSERT_EQ(window.median(), 4);
+    ASSERT_EQ(window.quantile(0), 1);
+    ASSERT_EQ(window.quantile(1), 5);
+
+    // 5 and 1 fall out of the window
+    for (int sample : { 2, 8, 9 }) {
+        window.push(sample);
+    }
+    ASSERT_EQ(window.size(), 4);
+    ASSERT_EQ(window.quantile(0), 2);
+    ASSERT_EQ(window.median(), 4);
+    ASSERT_EQ(window.quantile(0.99), 9);
+}
+
+TEST(SlidingQuantileTest, RandomAgainstSortedWindow) {
+    std::mt19937 mt {};
+    mt.seed(4040);
+    std::uniform_int_distribution<> dist { 0, 100 };
+
+    SlidingQuantile<int> window { 50 };
+    std::deque<int> arrivals;
+    for (int i = 0; i < 2000; ++i) {
+        int sample = dist(mt);
+        window.push(sample);
+        arrivals.push_back(sample);
+        if (arrivals.size() > 50) {
+            arrivals.pop_front();
+        }
+
+        std::vector<int> sorted(arrivals.begin(), arrivals.end());
+        std::ranges::sort(sorted);
+        for (double q : { 0.0, 0.1, 0.5, 0.9, 0.99, 1.0 }) {
+            auto rank = static_cast<size_t>(std::ceil(q * static_cast<double>(sorted.size())));
+            ASSERT_EQ(window.quantile(q), sorted[rank == 0 ? 0 : rank - 1]);
+        }
+    }
+}
+
+TEST(RedBlackIteratorTest, EmptyTree) {
+    RBTree<int> tree {};
+    ASSERT_EQ(tree.begin(), tree.end());
+    ASSERT_EQ(tree.lower_bound(3), tree.end());
+
+    int calls { 0 };
+    tree.for_each_in_range(0, 10, [&](int) { ++calls; });
+    ASSERT_EQ(calls, 0);
+}
+
+TEST(RedBlackIteratorTest, RandomIterationAndBounds) {
+    std::mt19937 mt {};
+    mt.seed(3030);
+    std::uniform_int_distribution<> dist { -300, 300 };
+
+    RBTree<int> tree {};
+    std::multiset<int> reference;
+    for (uint32_t i = 0; i < 2000; ++i) {
+        int num = dist(mt);
+        if (dist(mt) <= 100) {
+            tree.insert(num);
+            reference.insert(num);
+        } else if (reference.contains(num)) {
+            tree.deleteNode(num);
+            reference.erase(reference.find(num));
+        }
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+
+    ASSERT_TRUE(std::ranges::equal(tree, reference));
+    ASSERT_TRUE(std::equal(std::make_reverse_iterator(tree.end()), std::make_reverse_iterator(tree.begin()),
+                           reference.rbegin(), reference.rend()));
+
+    for (int i = 0; i < 500; ++i) {
+        int probe = dist(mt);
+        auto lower = tree.lower_bound(probe);
+        auto upper = tree.upper_bound(probe);
+        auto refLower = reference.lower_bound(probe);
+        auto refUpper = reference.upper_bound(probe);
+
+        ASSERT_EQ(lower == tree.end(), refLower == reference.end());
+        ASSERT_EQ(upper == tree.end(), refUpper == reference.end());
+        if (lower != tree.end()) {
+            ASSERT_EQ(*lower, *refLower);
+        }
+        if (upper != tree.end()) {
+            ASSERT_EQ(*upper, *refUpper);
+        }
+
+        auto [first, last] = tree.equal_range(probe);
+        ASSERT_EQ(std::distance(first, last), reference.count(probe));
+
+        auto [lo, hi] = std::minmax({ probe, dist(mt) });
+        std::vector<int> visited;
+        tree.for_each_in_range(lo, hi, [&](int val) { visited.push_back(val); });
+        ASSERT_TRUE(std::ranges::equal(visited, std::ranges::subrange(reference.lower_bound(lo),
+                                                                      reference.upper_bound(hi))));
+    }
+}
+
+TEST(RedBlackIteratorTest, IteratorsSurviveOtherDeletes) {
+    RBTree<int> tree {};
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(i);
+    }
+
+    auto it = tree.lower_bound(50);
+    for (int i = 0; i < 100; ++i) {
+        if (i != 50) {
+            ASSERT_TRUE(tree.deleteNode(i));
+            ASSERT_EQ(*it, 50);
+        }
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(tree.begin(), it);
+    ASSERT_EQ(std::next(it), tree.end());
+}
+
+TEST(RedBlackBulkTest, FromSortedSizes) {
+    for (int count = 0; count < 200; ++count) {
+        std::vector<int> data(count);
+        std::iota(data.begin(), data.end(), -count / 2);
+
+        auto tree = RBTree<int>::from_sorted(data);
+        ASSERT_TRUE(tree.checkInvariant()) << "Failed from_sorted with " << count << " elements";
+        ASSERT_EQ(tree.size(), data.size());
+        ASSERT_TRUE(std::ranges::equal(tree, data));
+
+        // the tree is still usable afterwards
+        tree.insert(count);
+        tree.deleteNode(-count / 2);
+        ASSERT_TRUE(tree.checkInvariant());
+    }
+}
+
+TEST(RedBlackBulkTest, JoinRandom) {
+    std::mt19937 mt {};
+    mt.seed(3131);
+    std::uniform_int_distribution<> sizeDist { 0, 300 };
+
+    for (int round = 0; round < 200; ++round) {
+        int leftCount = sizeDist(mt);
+        int rightCount = sizeDist(mt);
+
+        RBTree<int> left {};
+        for (int i = 0; i < leftCount; ++i) {
+            left.insert(i);
+        }
+        auto right = RBTree<int>::from_sorted(std::views::iota(leftCount + 1, leftCount + 1 + rightCount));
+
+        auto joined = RBTree<int>::join(std::move(left), leftCount, std::move(right));
+        ASSERT_TRUE(joined.checkInvariant());
+        ASSERT_EQ(joined.size(), leftCount + rightCount + 1);
+        ASSERT_EQ(left.size(), 0);
+        ASSERT_EQ(right.size(), 0);
+        ASSERT_TRUE(std::ranges::equal(joined, std::views::iota(0, leftCount + rightCount + 1)));
+
+        auto orderedJoined = OrderStatisticTree<int>::join(
+          OrderStatisticTree<int>::from_sorted(std::views::iota(0, leftCount)), leftCount,
+          OrderStatisticTree<int>::from_sorted(std::views::iota(leftCount + 1, leftCount + 1 + rightCount)));
+        ASSERT_TRUE(orderedJoined.checkInvariant());
+        ASSERT_EQ(orderedJoined.select(leftCount).value()->data, leftCount);
+    }
+}
+
+TEST(RedBlackBulkTest, SplitRandom) {
+    std::mt19937 mt {};
+    mt.seed(3132);
+    std::uniform_int_distribution<> dist { -500, 500 };
+
+    for (int round = 0; round < 200; ++round) {
+        RBTree<int> tree {};
+        OrderStatisticTree<int> ordered {};
+        std::multiset<int> reference;
+        for (int i = 0; i < 300; ++i) {
+            int num = dist(mt);
+            tree.insert(num);
+            ordered.insert(num);
+            reference.insert(num);
+        }
+
+        int key = dist(mt);
+        auto rest = tree.split(key);
+        auto orderedRest = ordered.split(key);
+
+        for (auto* half : { &tree, &rest }) {
+            ASSERT_TRUE(half->checkInvariant());
+        }
+        ASSERT_TRUE(ordered.checkInvariant());
+        ASSERT_TRUE(orderedRest.checkInvariant());
+
+        ASSERT_TRUE(std::ranges::equal(tree, std::ranges::subrange(reference.begin(), reference.lower_bound(key))));
+        ASSERT_TRUE(std::ranges::equal(rest, std::ranges::subrange(reference.lower_bound(key), reference.end())));
+        ASSERT_TRUE(std::ranges::equal(ordered, tree));
+        ASSERT_TRUE(std::ranges::equal(orderedRest, rest));
+
+        // both halves keep working, and can be joined back together
+        rest.insert(key);
+        tree.deleteNode(dist(mt));
+        ASSERT_TRUE(rest.checkInvariant());
+        ASSERT_TRUE(tree.checkInvariant());
+
+        if (rest.size() > 0) {
+            int pivot = *rest.begin();
+            rest.deleteNode(pivot);
+            auto joined = RBTree<int>::join(std::move(tree), pivot, std::move(rest));
+            ASSERT_TRUE(joined.checkInvariant());
+        }
+    }
+}
+
+TEST(RedBlackBulkTest, SplitJoinKeepsSlabsBounded) {
+    std::mt19937 mt {};
+    mt.seed(3134);
+    std::uniform_int_distribution<> dist { 1, 9998 };
+
+    RBTree<int> tree = RBTree<int>::from_sorted(std::views::iota(0, 10000));
+    size_t slabs = tree.pool().slabs();
+    for (int round = 0; round < 20; ++round) {
+        auto rest = tree.split(dist(mt));
+        int pivot = *rest.begin();
+        rest.deleteNode(pivot);
+        tree = RBTree<int>::join(std::move(tree), pivot, std::move(rest));
+
+        ASSERT_EQ(tree.size(), 10000);
+        // the pivot may need one new slab, but the shared slabs are never duplicated
+        ASSERT_LE(tree.pool().slabs(), slabs + 1);
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_TRUE(std::ranges::equal(tree, std::views::iota(0, 10000)));
+}
+
+TEST(RedBlackBulkTest, BatchInsertEraseRandom) {
+    std::mt19937 mt {};
+    mt.seed(3133);
+    std::uniform_int_distribution<> dist { -2000, 2000 };
+
+    OrderStatisticTree<int> tree {};
+    std::multiset<int> reference;
+    // alternate small batches (sorted, one descent each) with ones big enough to relink the tree
+    for (size_t batchSize : { 1, 5, 2000, 40, 3, 600, 10, 5000, 1, 80 }) {
+        std::vector<int> batch;
+        for (size_t i = 0; i < batchSize; ++i) {
+            batch.push_back(dist(mt));
+        }
+        tree.insert_batch(batch);
+        reference.insert(batch.begin(), batch.end());
+        ASSERT_TRUE(tree.checkInvariant());
+        ASSERT_TRUE(std::ranges::equal(tree, reference));
+
+        std::vector<int> erase;
+        for (size_t i = 0; i < batchSize / 2 + 1; ++i) {
+            erase.push_back(dist(mt) % 2 == 0 ? dist(mt) : *std::next(reference.begin(), mt() % reference.size()));
+        }
+        size_t expected { 0 };
+        for (int val : erase) {
+            if (auto it = reference.find(val); it != reference.end()) {
+                reference.erase(it);
+                ++expected;
+            }
+        }
+        ASSERT_EQ(tree.erase_batch(erase), expected);
+        ASSERT_TRUE(tree.checkInvariant());
+        ASSERT_TRUE(std::ranges::equal(tree, reference));
+        for (size_t i = 0; i < reference.size(); i += 97) {
+            ASSERT_EQ(tree.select(i).value()->data, *std::next(reference.begin(), static_cast<long>(i)));
+        }
+    }
+
+    ASSERT_EQ(tree.erase_batch(std::vector<int>(reference.begin(), reference.end())), reference.size());
+    ASSERT_EQ(tree.size(), 0);
+    ASSERT_TRUE(tree.checkInvariant());
+}
+
+// keeps count of live instances, and its Compare throws once a countdown runs out
+struct Tracked {
+    static inline int live = 0;
+    static inline int comparesLeft = -1;
+
+    int value { 0 };
+
+    Tracked(int val)
+        : value { val } {
+        ++live;
+    }
+    Tracked()
+        : Tracked(0) {}
+    Tracked(const Tracked& other)
+        : Tracked(other.value) {}
+    auto operator=(const Tracked&) -> Tracked& = default;
+    ~Tracked() { --live; }
+
+    struct Less {
+        auto operator()(const Tracked& a, const Tracked& b) const -> bool {
+            if (comparesLeft == 0) {
+                throw std::runtime_error("compare failed");
+            }
+            --comparesLeft;
+            return a.value < b.value;
+        }
+    };
+};
+
+TEST(RedBlackBulkTest, BatchInsertThrowingCompare) {
+    RBTree<Tracked, Tracked::Less> tree {};
+    for (int i = 0; i < 100; i += 2) {
+        tree.insert(i);
+    }
+    std::vector<Tracked> batch;
+    for (int i = 1; i < 100; i += 2) {
+        batch.emplace_back(i);
+    }
+
+    // fail at every compare of the dense path in turn: sorting, then merging
+    for (int failAt = 0;; ++failAt) {
+        Tracked::comparesLeft = failAt;
+        try {
+            tree.insert_batch(batch);
+        } catch (const std::runtime_error&) {
+            Tracked::comparesLeft = -1;
+            ASSERT_EQ(tree.size(), 50);
+            ASSERT_EQ(static_cast<size_t>(Tracked::live), tree.size() + batch.size());
+            continue;
+        }
+        Tracked::comparesLeft = -1;
+        break;
+    }
+    ASSERT_EQ(tree.size(), 100);
+    ASSERT_TRUE(tree.checkInvariant());
+}
+
+TEST(RedBlackBulkTest, BatchEraseThrowingCompare) {
+    RBTree<Tracked, Tracked::Less> tree {};
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(i);
+    }
+    std::vector<Tracked> batch;
+    for (int i = 0; i < 100; i += 2) {
+        batch.emplace_back(i);
+    }
+
+    // fail at every compare of the dense path in turn: sorting, then partitioning
+    for (int failAt = 0;; ++failAt) {
+        Tracked::comparesLeft = failAt;
+        try {
+            ASSERT_EQ(tree.erase_batch(batch), 50);
+        } catch (const std::runtime_error&) {
+            Tracked::comparesLeft = -1;
+            ASSERT_EQ(tree.size(), 100);
+            ASSERT_TRUE(tree.checkInvariant());
+            ASSERT_EQ(static_cast<size_t>(Tracked::live), tree.size() + batch.size());
+            continue;
+        }
+        Tracked::comparesLeft = -1;
+        break;
+    }
+    ASSERT_EQ(tree.size(), 50);
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(static_cast<size_t>(Tracked::live), tree.size() + batch.size());
+}
+
+TEST(RedBlackBulkTest, BatchDuplicates) {
+    RBTree<int> tree {};
+    tree.insert_batch(std::vector { 3, 1, 3, 3, 2 });
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(i);
+    }
+    tree.insert_batch(std::vector { 3, 3 });
+    ASSERT_EQ(std::ranges::count(tree, 3), 6);
+
+    ASSERT_EQ(tree.erase_batch(std::vector { 3, 3, 3, 3, 200, -1 }), 4);
+    ASSERT_EQ(std::ranges::count(tree, 3), 2);
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(tree.size(), 103);
+}
+
+TEST(BTreeTest, SingleElement) {
+    BTree<int> tree;
+    ASSERT_EQ(tree.size(), 0);
+    ASSERT_EQ(tree.search(10), std::nullopt);
+    ASSERT_FALSE(tree.deleteNode(10));
+
+    tree.insert(10);
+    ASSERT_EQ(tree.size(), 1);
+    ASSERT_EQ(tree.search(10).value()->data, 10);
+
+    ASSERT_TRUE(tree.deleteNode(10));
+    ASSERT_EQ(tree.size(), 0);
+    ASSERT_TRUE(tree.checkInvariant());
+}
+
+template <typename Tree>
+void randomInsertDelete(Tree& tree, uint32_t seed) {
+    std::mt19937 mt {};
+    mt.seed(seed);
+    std::uniform_int_distribution<> dist { -500, 500 };
+
+    std::multiset<int> reference;
+    for (uint32_t i = 0; i < 20000; ++i) {
+        int num = dist(mt);
+        if (dist(mt) <= 100) {
+            tree.insert(num);
+            reference.insert(num);
+        } else {
+            bool exists = reference.contains(num);
+            ASSERT_EQ(tree.deleteNode(num), exists);
+            if (exists) {
+                reference.erase(reference.find(num));
+            }
+        }
+        ASSERT_EQ(tree.size(), reference.size());
+
+        int probe = dist(mt);
+        auto found = tree.search(probe);
+        ASSERT_EQ(found.has_value(), reference.contains(probe));
+        if (found.has_value()) {
+            ASSERT_EQ(found.value()->data, probe);
+        }
+        if (i % 100 == 0) {
+            ASSERT_TRUE(tree.checkInvariant());
+        }
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+}
+
+TEST(BTreeTest, RandomInsertDeleteSmallNodes) {
+    // 3 keys per node, so splits and merges happen constantly
+    BTree<int, std::less<int>, 16> tree;
+    ASSERT_EQ(tree.nodeCapacity(), 3);
+    randomInsertDelete(tree, 3232);
+}
+
+TEST(BTreeTest, RandomInsertDeleteDefaultNodes) {
+    BTree<int> tree;
+    randomInsertDelete(tree, 3233);
+}
+
+TEST(BTreeTest, RandomInsertDeleteWideKeys) {
+    // 8 byte keys take fewer keys per vector in the linear scan
+    BTree<double> tree;
+    for (int i = 0; i < 3000; ++i) {
+        tree.insert((i * 7919) % 3000);
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+    for (int i = 0; i < 3000; i += 3) {
+        ASSERT_TRUE(tree.deleteNode(i));
+        ASSERT_EQ(tree.search(i + 1).value()->data, i + 1);
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(tree.size(), 2000);
+}
+
+TEST(BTreeTest, MoveAssign) {
+    BTree<int> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(i);
+    }
+    BTree<int> other;
+    other.insert(-1);
+    other = std::move(tree);
+    ASSERT_EQ(other.size(), 1000);
+    ASSERT_EQ(other.search(-1), std::nullopt);
+    ASSERT_TRUE(other.checkInvariant());
+}
+
+TEST(BTreeTest, RandomInsertDeleteCustomCompare) {
+    // greater<> uses the branchless binary search instead of the linear scan
+    BTree<int, std::greater<int>, 64> tree;
+    randomInsertDelete(tree, 3234);
+}
+
+TEST(BTreeTest, Strings) {
+    BTree<std::string> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(std::to_string(i));
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(tree.search("500").value()->data, "500");
+    for (int i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE(tree.deleteNode(std::to_string(i)));
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(tree.size(), 500);
+    ASSERT_EQ(tree.search("500"), std::nullopt);
+    ASSERT_NE(tree.search("501"), std::nullopt);
+}
+
+TEST(PersistentRedBlackTest, RandomInsertDelete) {
+    PersistentRBTree<int> tree;
+    randomInsertDelete(tree, 3236);
+}
+
+TEST(PersistentRedBlackTest, SnapshotsDontChange) {
+    std::mt19937 mt {};
+    mt.seed(3237);
+    std::uniform_int_distribution<> dist { 0, 300 };
+
+    PersistentRBTree<int> tree;
+    std::multiset<int> reference;
+    std::vector<std::pair<PersistentRBTree<int>, std::vector<int>>> snapshots;
+    for (int i = 0; i < 5000; ++i) {
+        int num = dist(mt);
+        if (dist(mt) < 180) {
+            tree.insert(num);
+            reference.insert(num);
+        } else if (tree.deleteNode(num)) {
+            reference.erase(reference.find(num));
+        }
+        if (i % 250 == 0) {
+            snapshots.emplace_back(tree.snapshot(), std::vector<int>(reference.begin(), reference.end()));
+        }
+    }
+    ASSERT_TRUE(std::ranges::equal(tree, reference));
+
+    for (auto& [snapshot, contents] : snapshots) {
+        ASSERT_TRUE(snapshot.checkInvariant());
+        ASSERT_TRUE(std::ranges::equal(snapshot, contents));
+    }
+
+    // snapshots can be modified too, without affecting the other versions
+    auto& [snapshot, contents] = snapshots[3];
+    for (int value : contents) {
+        ASSERT_TRUE(snapshot.deleteNode(value));
+    }
+    ASSERT_EQ(snapshot.size(), 0);
+    ASSERT_TRUE(std::ranges::equal(snapshots[4].first, snapshots[4].second));
+    ASSERT_TRUE(std::ranges::equal(tree, reference));
+}
+
+TEST(PersistentRedBlackTest, ReadSnapshotWhileWriting) {
+    PersistentRBTree<int> tree;
+    for (int i = 0; i < 10000; ++i) {
+        tree.insert(i);
+    }
+    auto snapshot = tree.snapshot();
+
+    std::thread reader { [&snapshot] {
+        for (int round = 0; round < 20; ++round) {
+            long sum { 0 };
+            for (int value : snapshot) {
+                sum += value;
+            }
+            ASSERT_EQ(sum, 49995000L);
+        }
+    } };
+    for (int i = 0; i < 10000; i += 2) {
+        tree.deleteNode(i);
+        tree.insert(i + 20000);
+    }
+    reader.join();
+
+    ASSERT_EQ(snapshot.size(), 10000);
+    ASSERT_TRUE(snapshot.checkInvariant());
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(tree.search(0), std::nullopt);
+    ASSERT_EQ(snapshot.search(0).value()->data, 0);
+}
+
+TEST(ShardedRedBlackTest, RandomAgainstMultiset) {
+    std::mt19937 mt {};
+    mt.seed(3939);
+    std::uniform_int_distribution<> dist { -1000, 1000 };
+
+    std::vector<int> sample(500);
+    std::ranges::generate(sample, [&] { return dist(mt); });
+    auto tree = ShardedRBTree<int>::from_sample(sample, 8);
+    ASSERT_EQ(tree.shards(), 8);
+
+    std::multiset<int> reference;
+    for (int i = 0; i < 20000; ++i) {
+        int num = dist(mt);
+        if (dist(mt) <= 100) {
+            tree.insert(num);
+            reference.insert(num);
+        } else {
+            bool exists = reference.contains(num);
+            ASSERT_EQ(tree.deleteNode(num), exists);
+            if (exists) {
+                reference.erase(reference.find(num));
+            }
+        }
+        int probe = dist(mt);
+        ASSERT_EQ(tree.search(probe), reference.contains(probe) ? std::optional { probe } : std::nullopt);
+    }
+    ASSERT_EQ(tree.size(), reference.size());
+    ASSERT_TRUE(tree.checkInvariant());
+
+    std::vector<int> inRange;
+    tree.for_each_in_range(-600, 700, [&](int val) { inRange.push_back(val); });
+    ASSERT_TRUE(std::ranges::equal(inRange, std::ranges::subrange(reference.lower_bound(-600), reference.upper_bound(700))));
+}
+
+TEST(ShardedRedBlackTest, ConcurrentWriters) {
+    ShardedRBTree<int> tree { { 1000, 2000, 3000 } };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&tree, t] {
+            // every thread owns the keys equal to t mod 4, spread over all shards
+            for (int i = t; i < 4000; i += 4) {
+                tree.insert(i);
+            }
+            for (int i = t; i < 4000; i += 8) {
+                EXPECT_TRUE(tree.deleteNode(i));
+            }
+            for (int i = t; i < 4000; i += 4) {
+                EXPECT_EQ(tree.contains(i), i % 8 != t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(tree.size(), 2000);
+    ASSERT_TRUE(tree.checkInvariant());
+}
+
+TEST(CompactRedBlackTest, RandomInsertDelete) {
+    CompactRBTree<int> tree;
+    randomInsertDelete(tree, 3235);
+}
+
+TEST(CompactRedBlackTest, ReusesFreedSlots) {
+    CompactRBTree<int> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(i);
+    }
+    size_t memory = tree.memoryUsage();
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 1000; i += 2) {
+            ASSERT_TRUE(tree.deleteNode(i));
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            tree.insert(i);
+        }
+    }
+    ASSERT_EQ(tree.memoryUsage(), memory);
+    ASSERT_EQ(tree.size(), 1000);
+    ASSERT_TRUE(tree.checkInvariant());
+
+    tree.clear();
+    ASSERT_EQ(tree.size(), 0);
+    ASSERT_EQ(tree.search(5), std::nullopt);
+    ASSERT_TRUE(tree.checkInvariant());
+    tree.insert(5);
+    ASSERT_EQ(tree.search(5).value()->data, 5);
+}
+
+TEST(CompactRedBlackTest, SerializeRoundTrip) {
+    CompactRBTree<int> tree;
+    for (int i = 0; i < 500; ++i) {
+        tree.insert((i * 37) % 500);
+    }
+    for (int i = 0; i < 500; i += 3) {
+        tree.deleteNode(i);
+    }
+
+    std::stringstream stream;
+    tree.serialize(stream);
+    auto restored = CompactRBTree<int>::deserialize(stream);
+    ASSERT_TRUE(restored.checkInvariant());
+    ASSERT_EQ(restored.size(), tree.size());
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_EQ(restored.search(i).has_value(), i % 3 != 0);
+    }
+
+    // the free list survives, so deleted slots are still reused
+    restored.insert(0);
+    ASSERT_TRUE(restored.checkInvariant());
+
+    std::stringstream truncated { "abc" };
+    ASSERT_THROW(CompactRBTree<int>::deserialize(truncated), std::runtime_error);
+
+    // root, free list, size, node count
+    auto corrupt = [&](std::array<uint64_t, 4> header) {
+        std::string bytes = stream.str();
+        std::memcpy(bytes.data(), header.data(), sizeof(header));
+        std::stringstream corrupted { bytes };
+        return CompactRBTree<int>::deserialize(corrupted);
+    };
+    constexpr uint64_t nil = 0x7FFF'FFFF;
+    uint64_t nodes = (stream.str().size() - 4 * sizeof(uint64_t)) / sizeof(CompactRBTree<int>::Node);
+    // in range, but the tree doesn't have 0 nodes and the rest aren't on the free list
+    ASSERT_THROW(corrupt({ 0, nil, 0, nodes }), std::runtime_error);
+    ASSERT_THROW(corrupt({ 7, nil, 1, 1 }), std::runtime_error);
+    ASSERT_THROW(corrupt({ 0, nodes, 0, nodes }), std::runtime_error);
+    ASSERT_THROW(corrupt({ 0, nil, nodes + 1, nodes }), std::runtime_error);
+    ASSERT_THROW(corrupt({ nil, nil, 0, nil }), std::runtime_error);
+    // a plausible header over a stream that ends early doesn't allocate the claimed nodes
+    ASSERT_THROW(corrupt({ 0, nil, 0, nil - 1 }), std::runtime_error);
+
+    // a node whose left link points past the end; for int the links follow the data
+    std::string bytes = stream.str();
+    auto badLink = static_cast<uint32_t>(nodes + 5);
+    std::memcpy(bytes.data() + 4 * sizeof(uint64_t) + sizeof(int), &badLink, sizeof(badLink));
+    std::stringstream badNode { bytes };
+    ASSERT_THROW((void)CompactRBTree<int>::deserialize(badNode), std::runtime_error);
+}
+
+TEST(CompactRedBlackTest, DeserializeRejectsCycles) {
+    // overwrite the link at the given byte offset of a node; for int, left is at 4,
+    // right at 8
+    auto withLink = [](const std::string& stream, uint32_t node, size_t offset, uint32_t link) {
+        std::string bytes = stream;
+        size_t at = 4 * sizeof(uint64_t) + node * sizeof(CompactRBTree<int>::Node) + offset;
+        std::memcpy(bytes.data() + at, &link, sizeof(link));
+        return std::stringstream { bytes };
+    };
+
+    // node 0 is the root and node 1 its right child
+    CompactRBTree<int> tree;
+    tree.insert(0);
+    tree.insert(1);
+    std::stringstream stream;
+    tree.serialize(stream);
+    auto valid = withLink(stream.str(), 1, 8, 0x7FFF'FFFF);
+    ASSERT_EQ(CompactRBTree<int>::deserialize(valid).size(), 2);
+
+    auto cyclic = withLink(stream.str(), 1, 8, 0);
+    ASSERT_THROW((void)CompactRBTree<int>::deserialize(cyclic), std::runtime_error);
+
+    // node 1 was erased and heads the free list, which now loops back on itself
+    tree.deleteNode(1);
+    std::stringstream withFree;
+    tree.serialize(withFree);
+    auto freed = withLink(withFree.str(), 1, 4, 0x7FFF'FFFF);
+    ASSERT_EQ(CompactRBTree<int>::deserialize(freed).size(), 1);
+    auto freeCycle = withLink(withFree.str(), 1, 4, 1);
+    ASSERT_THROW((void)CompactRBTree<int>::deserialize(freeCycle), std::runtime_error);
+    // or runs into the tree
+    auto freeIntoTree = withLink(withFree.str(), 1, 4, 0);
+    ASSERT_THROW((void)CompactRBTree<int>::deserialize(freeIntoTree), std::runtime_error);
+}
+
+TEST(CompactRedBlackTest, Strings) {
+    CompactRBTree<std::string> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE(tree.deleteNode(std::to_string(i)));
+    }
+    ASSERT_TRUE(tree.checkInvariant());
+    ASSERT_EQ(tree.size(), 500);
+    ASSERT_EQ(tree.search("500"), std::nullopt);
+    ASSERT_EQ(tree.search("501").value()->data, "501");
+}
+
+// counts copies and moves so tests can check that elements are built in place
+struct Payload {
+    static inline int copies = 0;
+    static inline int moves = 0;
+
+    std::string text;
+
+    explicit Payload(std::string str)
+        : text { std::move(str) } {}
+    Payload(const Payload& other)
+        : text { other.text } {
+        ++copies;
+    }
+    Payload(Payload&& other) noexcept
+        : text { std::move(other.text) } {
+        ++moves;
+    }
+    auto operator=(const Payload&) -> Payload& = delete;
+    auto operator=(Payload&&) -> Payload& = delete;
+    ~Payload() = default;
+};
+
+TEST(RBMapTest, TryEmplaceAndLookup) {
+    RBMap<std::string, int> map {};
+    auto [first, inserted] = map.try_emplace("b", 2);
+    ASSERT_TRUE(inserted);
+    ASSERT_EQ(first->data.first, "b");
+    ASSERT_EQ(first->data.second, 2);
+
+    map.try_emplace("a", 1);
+    map.try_emplace("c", 3);
+    auto [existing, insertedAgain] = map.try_emplace("b", 20);
+    ASSERT_FALSE(insertedAgain);
+    ASSERT_EQ(existing->data.second, 2);
+    ASSERT_EQ(map.size(), 3);
+
+    // lookups only need the key
+    map.search("c").value()->data.second = 30;
+    ASSERT_EQ(map.search(std::string("c")).value()->data.second, 30);
+    ASSERT_EQ(map.search("d"), std::nullopt);
+    ASSERT_EQ(map.lower_bound("bb")->first, "c");
+
+    ASSERT_TRUE(map.deleteNode("a"));
+    ASSERT_FALSE(map.deleteNode("a"));
+    ASSERT_TRUE(map.checkInvariant());
+}
+
+TEST(RBMapTest, HeterogeneousLookup) {
+    RBMap<std::string, int, std::less<>> map {};
+    for (int i = 0; i < 100; ++i) {
+        map.try_emplace(std::to_string(i), i);
+    }
+
+    std::string_view key = "42";
+    ASSERT_EQ(map.search(key).value()->data.second, 42);
+    ASSERT_EQ(map.upper_bound(key)->first, "43");
+    ASSERT_TRUE(map.deleteNode(key));
+    ASSERT_EQ(map.search(key), std::nullopt);
+
+    RBTree<std::string, std::less<>> set {};
+    set.insert("apple");
+    set.insert("banana");
+    ASSERT_NE(set.search(std::string_view { "banana" }), std::nullopt);
+    auto [lower, upper] = set.equal_range(std::string_view { "apple" });
+    ASSERT_EQ(std::distance(lower, upper), 1);
+}
+
+// counts conversions from string literals, to check how often a lookup converts its probe
+struct CountedKey {
+    static inline int conversions = 0;
+
+    std::string text;
+
+    explicit CountedKey(std::string str)
+        : text { std::move(str) } {}
+    CountedKey(const char* str)
+        : text { str } {
+        ++conversions;
+    }
+    auto operator<=>(const CountedKey&) const = default;
+};
+
+TEST(RBMapTest, ProbeConvertedOnce) {
+    RBMap<CountedKey, int> map {};
+    for (int i = 0; i < 1000; ++i) {
+        map.try_emplace(CountedKey { std::to_string(i) }, i);
+    }
+
+    CountedKey::conversions = 0;
+    ASSERT_EQ(map.search("500").value()->data.second, 500);
+    ASSERT_EQ(CountedKey::conversions, 1);
+    ASSERT_EQ(map.lower_bound("5000")->first.text, "501");
+    ASSERT_EQ(CountedKey::conversions, 2);
+
+    auto [node, inserted] = map.try_emplace("new", -1);
+    ASSERT_TRUE(inserted);
+    ASSERT_EQ(node->data.first.text, "new");
+    ASSERT_EQ(CountedKey::conversions, 3);
+    ASSERT_FALSE(map.try_emplace("new", -2).second);
+    ASSERT_EQ(CountedKey::conversions, 4);
+    ASSERT_TRUE(map.checkInvariant());
+}
+
+TEST(RBMapTest, InPlaceConstruction) {
+    Payload::copies = 0;
+    Payload::moves = 0;
+
+    RBMap<int, Payload> map {};
+    map.try_emplace(1, "one");
+    map.try_emplace(1, "ignored");
+    map.emplace(std::piecewise_construct, std::forward_as_tuple(2), std::forward_as_tuple("two"));
+    ASSERT_EQ(Payload::copies, 0);
+    ASSERT_EQ(Payload::moves, 0);
+    ASSERT_EQ(map.search(1).value()->data.second.text, "one");
+
+    // inserting an rvalue moves it into the node exactly once
+    map.insert(std::pair<const int, Payload> { 3, Payload { "three" } });
+    ASSERT_EQ(Payload::copies, 0);
+    ASSERT_EQ(map.search(3).value()->data.second.text, "three");
+
+    for (int key : { 2, 1, 3 }) {
+        ASSERT_TRUE(map.deleteNode(key));
+        ASSERT_TRUE(map.checkInvariant());
+    }
+    ASSERT_EQ(map.size(), 0);
+}
+
+TEST(RBMapTest, RandomAgainstStdMap) {
+    std::mt19937 mt {};
+    mt.seed(3333);
+    std::uniform_int_distribution<> dist { 0, 300 };
+
+    RBMap<int, int> map {};
+    std::map<int, int> reference;
+    for (int i = 0; i < 5000; ++i) {
+        int key = dist(mt);
+        int value = dist(mt);
+        if (value % 3 != 0) {
+            auto [node, inserted] = map.try_emplace(key, value);
+            auto [it, refInserted] = reference.try_emplace(key, value);
+            ASSERT_EQ(inserted, refInserted);
+            ASSERT_EQ(node->data.second, it->second);
+        } else {
+            ASSERT_EQ(map.deleteNode(key), reference.erase(key) == 1);
+        }
+        ASSERT_TRUE(map.checkInvariant());
+    }
+    ASSERT_TRUE(std::ranges::equal(map, reference));
+}
+
+TEST(IntervalTreeTest, Simple) {
+    IntervalTree<int> tree {};
+    ASSERT_EQ(tree.any_overlap(0, 100), std::nullopt);
+
+    tree.insert(10, 20);
+    tree.insert(15, 25);
+    tree.insert(30, 40);
+    tree.insert(5, 8);
+
+    auto overlap = tree.any_overlap(18, 31);
+    ASSERT_EQ(overlap, (Interval<int> { 10, 20 }));
+    ASSERT_EQ(tree.any_overlap(25, 30), std::nullopt);
+    ASSERT_EQ(tree.any_overlap(8, 10), std::nullopt);
+
+    std::vector<Interval<int>> stabbed;
+    tree.for_each_containing(16, [&](const Interval<int>& interval) { stabbed.push_back(interval); });
+    ASSERT_EQ(stabbed, (std::vector<Interval<int>> { { 10, 20 }, { 15, 25 } }));
+
+    // end points are exclusive
+    stabbed.clear();
+    tree.for_each_containing(20, [&](const Interval<int>& interval) { stabbed.push_back(interval); });
+    ASSERT_EQ(stabbed, (std::vector<Interval<int>> { { 15, 25 } }));
+
+    ASSERT_TRUE(tree.erase({ 15, 25 }));
+    ASSERT_FALSE(tree.erase({ 15, 25 }));
+    ASSERT_EQ(tree.any_overlap(21, 30), std::nullopt);
+    ASSERT_TRUE(tree.checkInvariant());
+}
+
+TEST(IntervalTreeTest, RandomAgainstScan) {
+    std::mt19937 mt {};
+    mt.seed(3434);
+    std::uniform_int_distribution<> startDist { 0, 1000 };
+    std::uniform_int_distribution<> lengthDist { 1, 60 };
+
+    IntervalTree<int> tree {};
+    std::vector<Interval<int>> intervals;
+    for (int i = 0; i < 3000; ++i) {
+        if (intervals.empty() || startDist(mt) < 700) {
+            Interval<int> interval { startDist(mt), 0 };
+            interval.end = interval.start + lengthDist(mt);
+            tree.insert(interval);
+            intervals.push_back(interval);
+        } else {
+            size_t index = static_cast<size_t>(startDist(mt)) % intervals.size();
+            ASSERT_TRUE(tree.erase(intervals[index]));
+            intervals.erase(intervals.begin() + static_cast<long>(index));
+        }
+        ASSERT_TRUE(tree.checkInvariant());
+
+        int start = startDist(mt);
+        int end = start + lengthDist(mt);
+        std::vector<Interval<int>> expected;
+        std::ranges::copy_if(intervals, std::back_inserter(expected),
+                             [&](const Interval<int>& interval) { return interval.start < end && start < interval.end; });
+        std::ranges::sort(expected, IntervalCompare<int> {});
+
+        std::vector<Interval<int>> found;
+        tree.for_each_overlapping(start, end, [&](const Interval<int>& interval) { found.push_back(interval); });
+        ASSERT_EQ(found, expected);
+
+        auto any = tree.any_overlap(start, end);
+        ASSERT_EQ(any.has_value(), !expected.empty());
+        if (any.has_value()) {
+            ASSERT_EQ(*any, expected.front());
+        }
+
+        std::vector<Interval<int>> containing;
+        tree.for_each_containing(start, [&](const Interval<int>& interval) { containing.push_back(interval); });
+        ASSERT_TRUE(std::ranges::all_of(containing, [&](const Interval<int>& interval) {
+            return interval.start <= start && start < interval.end;
+        }));
+        ASSERT_EQ(containing.size(), std::ranges::count_if(intervals, [&](const Interval<int>& interval) {
+                      return interval.start <= start && start < interval.end;
+                  }));
+    }
+}
@@ -1,32 +1,201 @@
+#pragma once
+
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <climits>
 #include <functional>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <tuple>
 #include <optional>
-#include <queue>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <features.h>
 #include <unistd.h>
 
-template <typename T, typename Compare = std::less<T>>
+#include "node_pool.hpp"
+
+/*
+ * Augmentations store an extra value in every node that is computed from the node's
+ * data and its children's values. The tree keeps them up to date through rotations,
+ * insertions and deletions.
+ *
+ *  - value_type                                  value stored per node
+ *  - compute(data, const value_type* left,       recompute a node's value. Missing
+ *            const value_type* right)            children are passed as nullptr
+ */
+struct NoAugment {
+    struct value_type {
+        auto operator==(const value_type&) const -> bool = default;
+    };
+
+    template <typename T>
+    static auto compute(const T&, const value_type*, const value_type*) -> value_type {
+        return {};
+    }
+};
+
+/*
+ * Number of nodes in each subtree. Enables select() and rank().
+ */
+struct SubtreeSize {
+    using value_type = size_t;
+
+    template <typename T>
+    static auto compute(const T&, const size_t* left, const size_t* right) -> size_t {
+        return 1 + (left ? *left : 0) + (right ? *right : 0);
+    }
+};
+
+/*
+ * Comparators with is_transparent allow lookups by any type they can compare against T,
+ * such as std::string_view for std::string keys.
+ */
+template <typename Compare>
+concept TransparentCompare = requires { typename Compare::is_transparent; };
+
+template <typename T>
+struct IsPair : std::false_type {};
+
+template <typename First, typename Second>
+struct IsPair<std::pair<First, Second>> : std::true_type {};
+
+/*
+ * Orders the (key, value) pairs of an RBMap by key. It's always transparent, so the
+ * map can be probed with a bare key. Other probe types are only compared as they are
+ * if Compare is transparent; otherwise RBTree converts them to K once before it
+ * descends, instead of Compare converting them at every node.
+ */
+template <typename K, typename V, typename Compare>
+struct MapCompare {
+    using is_transparent = void;
+    using key_type = K;
+
+    static constexpr bool heterogeneous = TransparentCompare<Compare>;
+
+    template <typename L>
+    static constexpr bool comparable = heterogeneous || std::is_same_v<L, K> || std::is_same_v<L, std::pair<const K, V>>;
+
+    static auto key(const std::pair<const K, V>& entry) noexcept -> const K& { return entry.first; }
+
+    template <typename L>
+    static auto key(const L& key) noexcept -> const L& {
+        return key;
+    }
+
+    template <typename A, typename B>
+        requires(comparable<A> && comparable<B>)
+    auto operator()(const A& lhs, const B& rhs) const -> bool {
+        return Compare {}(key(lhs), key(rhs));
+    }
+};
+
+template <typename T, typename Compare = std::less<T>, template <typename> class NodePool = SlabPool,
+          typename Augment = NoAugment>
 class RBTree {
     enum class Color { Red, Black };
 
+public:
+    // only data is accessible outside the tree
     struct Node {
         T data {};
 
-        friend class RBTree<T, Compare>;
+        template <typename... Args>
+        explicit Node(std::in_place_t, Args&&... args)
+            : data(std::forward<Args>(args)...) {}
+
+        friend class RBTree;
 
     private:
         Node* left { nullptr };
         Node* right { nullptr };
         Node* parent { nullptr };
         Color color { Color::Red };
+        [[no_unique_address]] typename Augment::value_type aug {};
     };
 
+private:
+    static constexpr bool augmented = !std::is_same_v<Augment, NoAugment>;
+
+    // batches at least 1 / denseBatchRatio of the tree's size relink the whole tree
+    static constexpr size_t denseBatchRatio = 4;
+
     Node* _root {};
     size_t _size { 0 };
+    NodePool<Node> _pool;
+
+    template <typename... Args>
+    auto createNode(Args&&... args) -> Node* {
+        Node* storage = _pool.allocate();
+        try {
+            return std::construct_at(storage, std::in_place, std::forward<Args>(args)...);
+        } catch (...) {
+            _pool.deallocate(storage);
+            throw;
+        }
+    }
+
+    void destroyNode(Node* node) noexcept {
+        std::destroy_at(node);
+        _pool.deallocate(node);
+    }
+
+    // post-order walk using the parent pointers, so no extra memory is needed
+    void destroyAll() noexcept {
+        Node* node = _root;
+        while (node != nullptr) {
+            if (node->left != nullptr) {
+                node = node->left;
+                continue;
+            }
+            if (node->right != nullptr) {
+                node = node->right;
+                continue;
+            }
+
+            Node* parent = node->parent;
+            if (parent != nullptr) {
+                if (parent->left == node) {
+                    parent->left = nullptr;
+                } else {
+                    parent->right = nullptr;
+                }
+            }
+            destroyNode(node);
+            node = parent;
+        }
+    }
+
+    // copy of source's data, color and augmentation, attached below parent
+    auto cloneNode(const Node* source, Node* parent) -> Node* {
+        Node* node = createNode(source->data);
+        node->color = source->color;
+        node->aug = source->aug;
+        node->parent = parent;
+        return node;
+    }
+
+    static auto updateAugment(Node* node) -> void {
+        if constexpr (augmented) {
+            node->aug = Augment::compute(node->data, node->left ? &node->left->aug : nullptr,
+                                         node->right ? &node->right->aug : nullptr);
+        }
+    }
+
+    // recompute the augmented values from node up to the root
+    static auto updateAugmentPath(Node* node) -> void {
+        if constexpr (augmented) {
+            for (; node != nullptr; node = node->parent) {
+                updateAugment(node);
+            }
+        }
+    }
 
     inline auto isLeftChild(Node* node) -> bool {
         return node == nullptr || node->parent == nullptr ? false : node->parent->left == node;
@@ -62,6 +231,9 @@ class RBTree {
             rightChild->parent->right = rightChild;
         }
         node->parent = rightChild;
+
+        updateAugment(node);
+        updateAugment(rightChild);
     }
 
     void rotateRight(Node* node) {
@@ -90,18 +262,22 @@ class RBTree {
             leftChild->parent->right = leftChild;
         }
         node->parent = leftChild;
+
+        updateAugment(node);
+        updateAugment(leftChild);
     }
 
-    void fixInsertion(Node* insert) {
+    // returns whether the black height of the tree grew
+    auto fixInsertion(Node* insert) -> bool {
         if (insert->parent->color == Color::Black) {
-            return;
+            return false;
         }
 
         while (insert->parent != nullptr && insert->parent->parent != nullptr) {
             // both insert's uncle and parent are red
             Node* parent = insert->parent;
             if (parent->color != Color::Red) {
-                return;
+                return false;
             }
             Node* grandparent = insert->parent->parent;
             Node* uncle = isLeftChild(parent) ? grandparent->right : grandparent->left;
@@ -133,14 +309,16 @@ class RBTree {
                 } else {
                     rotateLeft(grandparent);
                 }
-                return;
+                return false;
             }
             insert = grandparent;
         }
 
         // this is always safe to do since it increases the black depth of
         // every path by 1
+        bool grew = _root->color == Color::Red;
         _root->color = Color::Black;
+        return grew;
     }
 
     void fixDeletion(Node* nodeToDelete) {
@@ -220,13 +398,15 @@ class RBTree {
             parent = current->parent;
         }
 
+        Node* deletedParent = nodeToDelete->parent;
         if (isLeftChild(nodeToDelete)) {
-            nodeToDelete->parent->left = nullptr;
+            deletedParent->left = nullptr;
         } else {
-            nodeToDelete->parent->right = nullptr;
+            deletedParent->right = nullptr;
         }
-        delete nodeToDelete;
+        destroyNode(nodeToDelete);
         nodeToDelete = nullptr;
+        updateAugmentPath(deletedParent);
 
         _root->color = Color::Black;
     }
@@ -249,29 +429,52 @@ class RBTree {
 
     void printTree(const Node* node) { printTree("", node, false); }
 
-    static auto checkInvariantHelper(Node* node, bool left) -> std::tuple<bool, int, int> {
-        // invariant, black count, largest
+    // black count of every path if node's subtree is valid, otherwise nothing
+    static auto checkInvariantHelper(Node* node) -> std::optional<int> {
         if (node == nullptr) {
-            return { true, 1, left ? INT_MIN : INT_MAX };
+            return 1;
         }
 
-        auto [lv, lb, le] = checkInvariantHelper(node->left, true);
-        auto [rv, rb, re] = checkInvariantHelper(node->right, false);
+        for (Node* child : { node->left, node->right }) {
+            if (child == nullptr) {
+                continue;
+            }
+            if (child->parent != node || (node->color == Color::Red && child->color == Color::Red)) {
+                return {};
+            }
+        }
 
-        if (!lv || !rv || (lb != rb) || (le > node->data || re < node->data)) {
-            return { false, -1, left ? INT_MAX : INT_MIN };
+        auto lb = checkInvariantHelper(node->left);
+        auto rb = checkInvariantHelper(node->right);
+        if (!lb || !rb || *lb != *rb) {
+            return {};
         }
+        return *lb + (node->color == Color::Black);
+    }
 
-        int opt { 0 };
-        if (left) {
-            opt = std::max(le, node->data);
-        } else {
-            opt = std::min(re, node->data);
+    auto checkOrder() const -> bool {
+        size_t count { 0 };
+        for (Node* node = minNode(_root); node != nullptr; node = nextNode(node)) {
+            Node* next = nextNode(node);
+            if (next != nullptr && Compare {}(next->data, node->data)) {
+                return false;
+            }
+            ++count;
         }
+        return count == _size;
+    }
 
-        return { true, lb + (node->color == Color::Black), opt };
+    static auto checkAugmentHelper(Node* node) -> bool {
+        if (node == nullptr) {
+            return true;
+        }
+        auto expected = Augment::compute(node->data, node->left ? &node->left->aug : nullptr,
+                                         node->right ? &node->right->aug : nullptr);
+        return node->aug == expected && checkAugmentHelper(node->left) && checkAugmentHelper(node->right);
     }
 
+    [[nodiscard]] static auto subtreeSize(const Node* node) noexcept -> size_t { return node ? node->aug : 0; }
+
     [[nodiscard]] static auto findInorderSuccessor(Node* root) -> Node* {
         if (root == nullptr || root->right == nullptr) {
             return root;
@@ -284,120 +487,357 @@ class RBTree {
         return right;
     }
 
-public:
-    RBTree() = default;
+    [[nodiscard]] static auto minNode(Node* node) noexcept -> Node* {
+        while (node != nullptr && node->left != nullptr) {
+            node = node->left;
+        }
+        return node;
+    }
 
-    ~RBTree() {
-        std::queue<Node*> bfs;
-        bfs.push(_root);
-        while (!bfs.empty()) {
-            auto front = bfs.front();
-            bfs.pop();
-            if (!front) {
-                continue;
-            }
-            bfs.push(front->left);
-            bfs.push(front->right);
+    [[nodiscard]] static auto maxNode(Node* node) noexcept -> Node* {
+        while (node != nullptr && node->right != nullptr) {
+            node = node->right;
+        }
+        return node;
+    }
 
-            delete front;
+    // in-order successor using the parent pointers, or nullptr for the last node
+    [[nodiscard]] static auto nextNode(Node* node) noexcept -> Node* {
+        if (node->right != nullptr) {
+            return minNode(node->right);
+        }
+        while (node->parent != nullptr && node->parent->right == node) {
+            node = node->parent;
         }
+        return node->parent;
     }
 
-    RBTree(RBTree<T>&& tree) {
-        std::swap(_root, tree._root);
-        std::swap(_size, tree._size);
+    // in-order predecessor using the parent pointers, or nullptr for the first node
+    [[nodiscard]] static auto prevNode(Node* node) noexcept -> Node* {
+        if (node->left != nullptr) {
+            return maxNode(node->left);
+        }
+        while (node->parent != nullptr && node->parent->left == node) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+
+    /*
+     * Exchange the positions (and colors) of node and its in-order successor without
+     * touching their data, so pointers to either stay valid. The successor is the
+     * leftmost node of node's right subtree, so it has no left child.
+     */
+    void swapWithSuccessor(Node* node, Node* successor) {
+        Node* parent = node->parent;
+        Node* successorParent = successor->parent;
+        Node* successorRight = successor->right;
+
+        if (parent == nullptr) {
+            _root = successor;
+        } else if (parent->left == node) {
+            parent->left = successor;
+        } else {
+            parent->right = successor;
+        }
+        successor->parent = parent;
+
+        successor->left = node->left;
+        successor->left->parent = successor;
+
+        if (successorParent == node) {
+            successor->right = node;
+            node->parent = successor;
+        } else {
+            successor->right = node->right;
+            successor->right->parent = successor;
+            successorParent->left = node;
+            node->parent = successorParent;
+        }
+
+        node->left = nullptr;
+        node->right = successorRight;
+        if (successorRight != nullptr) {
+            successorRight->parent = node;
+        }
+        std::swap(node->color, successor->color);
+
+        updateAugmentPath(node);
+    }
+
+    // map probes that Compare can't take as they are, see MapCompare
+    template <typename K>
+    static constexpr bool convertsProbe = requires {
+        typename Compare::key_type;
+        requires !Compare::template comparable<K>;
+    };
+
+    template <typename K>
+    [[nodiscard]] static auto probe(const K& key) -> decltype(auto) {
+        if constexpr (convertsProbe<K>) {
+            return typename Compare::key_type(key);
+        } else {
+            return (key);
+        }
     }
 
-    // RBTree(const RBTree<T>& tree) {
-    //     std::queue<Node*> bfs;
-    //     bfs.push(tree._root);
-    //     while (!bfs.empty()) {
-    //         auto front = bfs.front();
-    //         bfs.pop();
-    //         if (!front) {
-    //             continue;
-    //         }
-    //         bfs.push(front->left);
-    //         bfs.push(front->right);
-    //     }
-    // }
-
-    // this is still missing like half of the default constructors
-    // auto operator=(const RBTree<T>& tree) -> RBTree& {
-    //     std::swap(_root, tree._root);
-    //     std::swap(_size, tree._size);
-    //     return *this;
-    // }
-
-    auto insert(T data) -> const Node* {
+    template <typename K>
+    [[nodiscard]] auto findNode(const K& val) const -> Node* {
         Node* curr = _root;
-        std::unique_ptr<Node> insert(new Node());
-        insert->data = data;
+        while (curr != nullptr) {
+            if (Compare {}(val, curr->data)) {
+                curr = curr->left;
+            } else if (Compare {}(curr->data, val)) {
+                curr = curr->right;
+            } else {
+                return curr;
+            }
+        }
+        return nullptr;
+    }
 
-        if (curr == nullptr) {
-            _root = insert.release();
-            _root->color = Color::Black;
-            ++_size;
-            return _root;
+    template <typename K>
+    [[nodiscard]] auto lowerBoundNode(const K& val) const -> Node* {
+        Node* curr = _root;
+        Node* result = nullptr;
+        while (curr != nullptr) {
+            if (Compare {}(curr->data, val)) {
+                curr = curr->right;
+            } else {
+                result = curr;
+                curr = curr->left;
+            }
         }
+        return result;
+    }
 
+    template <typename K>
+    [[nodiscard]] auto upperBoundNode(const K& val) const -> Node* {
+        Node* curr = _root;
+        Node* result = nullptr;
         while (curr != nullptr) {
-            if (Compare {}(data, curr->data)) {
-                if (curr->left != nullptr) {
-                    curr = curr->left;
-                    continue;
+            if (Compare {}(val, curr->data)) {
+                result = curr;
+                curr = curr->left;
+            } else {
+                curr = curr->right;
+            }
+        }
+        return result;
+    }
+
+    // a detached subtree and the number of black nodes on each of its paths
+    struct Subtree {
+        Node* root { nullptr };
+        size_t blackHeight { 0 };
+    };
+
+    [[nodiscard]] static auto blackHeight(const Node* node) noexcept -> size_t {
+        size_t height { 0 };
+        for (; node != nullptr; node = node->left) {
+            height += node->color == Color::Black;
+        }
+        return height;
+    }
+
+    // cut a child off from its parent, making it the black root of its own subtree
+    [[nodiscard]] static auto detach(Node* child, size_t blackHeight) noexcept -> Subtree {
+        if (child == nullptr) {
+            return {};
+        }
+        child->parent = nullptr;
+        if (child->color == Color::Red) {
+            child->color = Color::Black;
+            ++blackHeight;
+        }
+        return { child, blackHeight };
+    }
+
+    /*
+     * Join two detached subtrees, where every element of left comes before pivot and
+     * every element of right comes after it. Walks down the inner spine of the taller
+     * tree, so it costs O(|difference in black height| + 1).
+     */
+    auto joinSubtrees(Subtree left, Node* pivot, Subtree right) -> Subtree {
+        pivot->parent = nullptr;
+        if (left.blackHeight == right.blackHeight) {
+            pivot->left = left.root;
+            pivot->right = right.root;
+            pivot->color = Color::Black;
+            for (Node* child : { left.root, right.root }) {
+                if (child != nullptr) {
+                    child->parent = pivot;
                 }
-                insert->parent = curr;
-                curr->left = insert.get();
-                break;
             }
-            if (curr->right != nullptr) {
-                curr = curr->right;
-                continue;
+            updateAugment(pivot);
+            return { pivot, left.blackHeight + 1 };
+        }
+
+        bool tallLeft = left.blackHeight > right.blackHeight;
+        Subtree tall = tallLeft ? left : right;
+        Subtree small = tallLeft ? right : left;
+
+        // find the first black node on the spine with the same black height as the
+        // smaller tree. nullptr counts as black with a height of 0
+        Node* parent = nullptr;
+        Node* curr = tall.root;
+        size_t height = tall.blackHeight;
+        while (!isBlackNode(curr) || height != small.blackHeight) {
+            height -= curr->color == Color::Black;
+            parent = curr;
+            curr = tallLeft ? curr->right : curr->left;
+        }
+
+        pivot->left = tallLeft ? curr : small.root;
+        pivot->right = tallLeft ? small.root : curr;
+        pivot->parent = parent;
+        pivot->color = Color::Red;
+        for (Node* child : { curr, small.root }) {
+            if (child != nullptr) {
+                child->parent = pivot;
+            }
+        }
+        if (tallLeft) {
+            parent->right = pivot;
+        } else {
+            parent->left = pivot;
+        }
+
+        _root = tall.root;
+        updateAugmentPath(pivot);
+        bool grew = fixInsertion(pivot);
+        return { _root, tall.blackHeight + grew };
+    }
+
+    // split a detached subtree into the elements less than key and the rest
+    auto splitSubtree(Subtree tree, const T& key) -> std::pair<Subtree, Subtree> {
+        Node* node = tree.root;
+        if (node == nullptr) {
+            return {};
+        }
+
+        size_t childHeight = tree.blackHeight - (node->color == Color::Black);
+        Subtree left = detach(node->left, childHeight);
+        Subtree right = detach(node->right, childHeight);
+        node->left = nullptr;
+        node->right = nullptr;
+
+        if (Compare {}(node->data, key)) {
+            auto [less, rest] = splitSubtree(right, key);
+            return { joinSubtrees(left, node, less), rest };
+        }
+        auto [less, rest] = splitSubtree(left, key);
+        return { less, joinSubtrees(rest, node, right) };
+    }
+
+    // link the next count nodes handed out by nextNode into a perfectly balanced subtree
+    template <typename NextNode>
+    auto linkBalanced(NextNode& nextNode, size_t count, size_t depth, size_t bottom) -> Node* {
+        if (count == 0) {
+            return nullptr;
+        }
+
+        size_t leftCount = (count - 1) / 2;
+        Node* left = linkBalanced(nextNode, leftCount, depth + 1, bottom);
+        Node* node = nextNode();
+        Node* right = linkBalanced(nextNode, count - 1 - leftCount, depth + 1, bottom);
+
+        node->left = left;
+        node->right = right;
+        for (Node* child : { left, right }) {
+            if (child != nullptr) {
+                child->parent = node;
             }
-            insert->parent = curr;
-            curr->right = insert.get();
-            break;
         }
+        // every path has the same number of nodes above the bottom level, so only
+        // the (possibly incomplete) bottom level is red
+        node->color = depth == bottom && depth > 0 ? Color::Red : Color::Black;
+        updateAugment(node);
+        return node;
+    }
+
+    // build a perfectly balanced subtree out of the next count elements of it
+    template <typename Iter>
+    auto buildSorted(Iter& it, size_t count) -> Node* {
+        auto nextNode = [&] {
+            Node* node = createNode(*it);
+            ++it;
+            return node;
+        };
+        return linkBalanced(nextNode, count, 0, std::bit_width(count) - 1);
+    }
+
+    // replace the tree with the given sorted nodes, relinked without any allocation
+    void relinkSorted(const std::vector<Node*>& nodes) {
+        auto it = nodes.begin();
+        auto nextNode = [&] { return *it++; };
+        _root = linkBalanced(nextNode, nodes.size(), 0, std::bit_width(nodes.size()) - 1);
+        if (_root != nullptr) {
+            _root->parent = nullptr;
+        }
+        _size = nodes.size();
+    }
+
+    [[nodiscard]] auto sortedNodes() const -> std::vector<Node*> {
+        std::vector<Node*> nodes;
+        nodes.reserve(_size);
+        for (Node* node = minNode(_root); node != nullptr; node = nextNode(node)) {
+            nodes.push_back(node);
+        }
+        return nodes;
+    }
+
+    // link a new node as the given child of parent (or as the root) and rebalance
+    void attach(Node* insert, Node* parent, bool left) {
         ++_size;
+        insert->parent = parent;
+        if (parent == nullptr) {
+            _root = insert;
+            _root->color = Color::Black;
+            updateAugment(_root);
+            return;
+        }
 
-        fixInsertion(insert.get());
-        return insert.release();
+        if (left) {
+            parent->left = insert;
+        } else {
+            parent->right = insert;
+        }
+        updateAugmentPath(insert);
+        fixInsertion(insert);
     }
 
-    auto deleteNode(const T& data) -> bool {
-        auto res = search(data);
-        if (!res.has_value()) {
+    auto eraseNode(Node* node) -> bool {
+        if (node == nullptr) {
             return false;
         }
 
         --_size;
 
-        // find and replace node with its inorder succesor (if it exists)
-        // and make that the successor the node we're going to delete
-        Node* node { res.value() };
+        // move the node into its inorder successor's place (if it has two children)
+        // so the node we're going to delete has at most one child
         if (node->left != nullptr && node->right != nullptr) {
-            auto succesor { findInorderSuccessor(node) };
-            std::swap(node->data, succesor->data);
-            node = succesor;
+            swapWithSuccessor(node, findInorderSuccessor(node));
         }
 
         if (node->left == nullptr && node->right == nullptr) {
             if (node == _root) {
-                delete node;
+                destroyNode(node);
                 _root = nullptr;
                 return true;
             }
             if (node->color == Color::Red) {
+                Node* parent = node->parent;
                 if (isLeftChild(node)) {
                     node->parent->left = nullptr;
-                    delete node;
+                    destroyNode(node);
                     node = nullptr;
                 } else {
                     node->parent->right = nullptr;
-                    delete node;
+                    destroyNode(node);
                     node = nullptr;
                 }
+                updateAugmentPath(parent);
                 return true;
             }
 
@@ -405,41 +845,589 @@ public:
             return true;
         }
 
-        // safe to just swap since there's only one child at most
-        // only has left child
-        if (node->left && !node->right) {
-            std::swap(node->data, node->left->data);
-            node->color = Color::Black;
-            delete node->left;
-            node->left = nullptr;
-            return true;
+        // a node with a single child must be black with a red leaf child,
+        // so the child can take its place and be recolored black
+        Node* child = node->left != nullptr ? node->left : node->right;
+        child->parent = node->parent;
+        if (node->parent == nullptr) {
+            _root = child;
+        } else if (isLeftChild(node)) {
+            node->parent->left = child;
+        } else {
+            node->parent->right = child;
         }
-
-        // has just right child
-        std::swap(node->data, node->right->data);
-        node->color = Color::Black;
-        delete node->right;
-        node->right = nullptr;
+        child->color = Color::Black;
+        destroyNode(node);
+        updateAugmentPath(child->parent);
         return true;
     }
 
+public:
+    /*
+     * Bidirectional iterator over the tree in sorted order. Moving it only follows the
+     * child and parent pointers, so iteration doesn't allocate. Iterators stay valid
+     * until the element they point to is deleted.
+     */
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = T;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        Iterator() = default;
+
+        auto operator*() const -> reference { return _node->data; }
+        auto operator->() const -> pointer { return &_node->data; }
+
+        auto operator++() -> Iterator& {
+            _node = nextNode(_node);
+            return *this;
+        }
+
+        auto operator++(int) -> Iterator {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        // decrementing end() moves to the largest element
+        auto operator--() -> Iterator& {
+            _node = _node == nullptr ? maxNode(_tree->_root) : prevNode(_node);
+            return *this;
+        }
+
+        auto operator--(int) -> Iterator {
+            Iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        friend auto operator==(const Iterator& a, const Iterator& b) -> bool { return a._node == b._node; }
+
+    private:
+        Node* _node { nullptr };
+        const RBTree* _tree { nullptr };
+
+        Iterator(Node* node, const RBTree* tree) noexcept
+            : _node { node }
+            , _tree { tree } {}
+        friend class RBTree;
+    };
+
+    RBTree() = default;
+
+    ~RBTree() { clear(); }
+
+    RBTree(RBTree&& tree) noexcept { swap(tree); }
+
+    /*
+     * Deep copy in O(n). The copy has the same shape and colors as tree, so nothing is
+     * rebalanced, and it's walked through the parent pointers without a stack.
+     */
+    RBTree(const RBTree& tree) {
+        if (tree._root == nullptr) {
+            return;
+        }
+        try {
+            _root = cloneNode(tree._root, nullptr);
+            const Node* source = tree._root;
+            Node* copy = _root;
+            while (source != nullptr) {
+                if (source->left != nullptr && copy->left == nullptr) {
+                    copy->left = cloneNode(source->left, copy);
+                    source = source->left;
+                    copy = copy->left;
+                } else if (source->right != nullptr && copy->right == nullptr) {
+                    copy->right = cloneNode(source->right, copy);
+                    source = source->right;
+                    copy = copy->right;
+                } else {
+                    source = source->parent;
+                    copy = copy->parent;
+                }
+            }
+        } catch (...) {
+            destroyAll();
+            throw;
+        }
+        _size = tree._size;
+    }
+
+    auto operator=(const RBTree& tree) -> RBTree& {
+        if (this != &tree) {
+            RBTree copy { tree };
+            swap(copy);
+        }
+        return *this;
+    }
+
+    auto operator=(RBTree&& tree) noexcept -> RBTree& {
+        RBTree moved { std::move(tree) };
+        swap(moved);
+        return *this;
+    }
+
+    void swap(RBTree& tree) noexcept {
+        std::swap(_root, tree._root);
+        std::swap(_size, tree._size);
+        std::swap(_pool, tree._pool);
+    }
+
+    /*
+     * Remove every node. Pools that support it drop their slabs wholesale, and the
+     * nodes are only visited one by one if T needs its destructor run.
+     */
+    void clear() noexcept {
+        constexpr bool canRelease = requires(NodePool<Node>& pool) { pool.release(); };
+        if constexpr (canRelease) {
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                destroyAll();
+            }
+            _pool.release();
+        } else {
+            destroyAll();
+        }
+        _root = nullptr;
+        _size = 0;
+    }
+
+    /*
+     * Build a tree from a range that is already sorted by Compare in O(n), without
+     * any rebalancing
+     */
+    template <std::ranges::forward_range R>
+    [[nodiscard]] static auto from_sorted(R&& range) -> RBTree {
+        RBTree tree {};
+        size_t count = std::ranges::distance(range);
+        if (count == 0) {
+            return tree;
+        }
+        auto it = std::ranges::begin(range);
+        tree._root = tree.buildSorted(it, count);
+        tree._size = count;
+        return tree;
+    }
+
+    /*
+     * Join two trees, where every element of left is before pivot and every element
+     * of right is after it. Costs O(log n).
+     */
+    [[nodiscard]] static auto join(RBTree&& left, T pivot, RBTree&& right) -> RBTree {
+        RBTree tree { std::move(left) };
+        tree._pool.merge(std::move(right._pool));
+
+        Node* node = tree.createNode(std::move(pivot));
+        Subtree joined = tree.joinSubtrees({ tree._root, blackHeight(tree._root) }, node,
+                                           { right._root, blackHeight(right._root) });
+        tree._root = joined.root;
+        tree._size += right._size + 1;
+
+        right._root = nullptr;
+        right._size = 0;
+        return tree;
+    }
+
+    /*
+     * Move every element that isn't less than key into a new tree, keeping the rest.
+     * The structural split is O(log n). Trees with the SubtreeSize augmentation know
+     * both sizes immediately, otherwise the smaller half is counted.
+     */
+    [[nodiscard]] auto split(const T& key) -> RBTree {
+        auto [less, rest] = splitSubtree({ _root, blackHeight(_root) }, key);
+
+        RBTree tree {};
+        tree._pool.share(_pool);
+        _root = less.root;
+        tree._root = rest.root;
+
+        if constexpr (std::is_same_v<Augment, SubtreeSize>) {
+            tree._size = subtreeSize(tree._root);
+        } else {
+            // walk both halves together and stop at the end of the shorter one
+            size_t counted { 0 };
+            Node* lessNode = minNode(_root);
+            Node* restNode = minNode(tree._root);
+            while (lessNode != nullptr && restNode != nullptr) {
+                lessNode = nextNode(lessNode);
+                restNode = nextNode(restNode);
+                ++counted;
+            }
+            tree._size = restNode == nullptr ? counted : _size - counted;
+        }
+        _size -= tree._size;
+        return tree;
+    }
+
+    /*
+     * Construct a new element in place from args. Equal elements are allowed, so this
+     * never fails; use try_emplace to keep keys unique.
+     */
+    template <typename... Args>
+    auto emplace(Args&&... args) -> Node* {
+        Node* insert = createNode(std::forward<Args>(args)...);
+
+        Node* parent = nullptr;
+        bool left { false };
+        for (Node* curr = _root; curr != nullptr; curr = left ? curr->left : curr->right) {
+            parent = curr;
+            left = Compare {}(insert->data, curr->data);
+        }
+        attach(insert, parent, left);
+        return insert;
+    }
+
+    auto insert(const T& data) -> const Node* { return emplace(data); }
+
+    auto insert(T&& data) -> const Node* { return emplace(std::move(data)); }
+
+    /*
+     * Insert an element with the given key, unless an equal one is already in the tree.
+     * The element is only constructed if it's inserted. For pairs (RBMap), the key and
+     * args construct the first and second members respectively.
+     */
+    template <typename K, typename... Args>
+    auto try_emplace(K&& key, Args&&... args) -> std::pair<Node*, bool> {
+        if constexpr (convertsProbe<std::remove_cvref_t<K>>) {
+            // the converted key is moved into the node if it's inserted
+            return try_emplace(typename Compare::key_type(std::forward<K>(key)), std::forward<Args>(args)...);
+        } else {
+            Node* parent = nullptr;
+            bool left { false };
+            for (Node* curr = _root; curr != nullptr; curr = left ? curr->left : curr->right) {
+                parent = curr;
+                if (Compare {}(key, curr->data)) {
+                    left = true;
+                } else if (Compare {}(curr->data, key)) {
+                    left = false;
+                } else {
+                    return { curr, false };
+                }
+            }
+
+            Node* insert { nullptr };
+            if constexpr (IsPair<T>::value) {
+                insert = createNode(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                    std::forward_as_tuple(std::forward<Args>(args)...));
+            } else {
+                insert = createNode(std::forward<K>(key), std::forward<Args>(args)...);
+            }
+            attach(insert, parent, left);
+            return { insert, true };
+        }
+    }
+
+    /*
+     * Insert every element of range. The batch is sorted first, so consecutive descents
+     * share most of their path and it stays in cache. Batches that are large compared to
+     * the tree are merged with it and the whole tree is relinked in O(n + k log k),
+     * which is O(1) per element once k is a fixed fraction of n. That path needs
+     * temporary vectors of node pointers: the tree's n nodes, the k new ones, and the
+     * n + k merged.
+     */
+    template <std::ranges::input_range R>
+    void insert_batch(R&& range) {
+        std::vector<T> batch(std::ranges::begin(range), std::ranges::end(range));
+        std::ranges::stable_sort(batch, Compare {});
+
+        if (batch.size() * denseBatchRatio >= _size) {
+            // every buffer is allocated up front, so only createNode and Compare can
+            // throw once there are new nodes to clean up
+            std::vector<Node*> existing = sortedNodes();
+            std::vector<Node*> inserted;
+            inserted.reserve(batch.size());
+            std::vector<Node*> nodes;
+            nodes.reserve(_size + batch.size());
+            try {
+                for (T& val : batch) {
+                    inserted.push_back(createNode(std::move(val)));
+                }
+                std::ranges::merge(existing, inserted, std::back_inserter(nodes),
+                                   [](Node* a, Node* b) { return Compare {}(a->data, b->data); });
+            } catch (...) {
+                for (Node* node : inserted) {
+                    destroyNode(node);
+                }
+                throw;
+            }
+            relinkSorted(nodes);
+            return;
+        }
+
+        for (T& val : batch) {
+            emplace(std::move(val));
+        }
+    }
+
+    /*
+     * Delete one element equal to each element of range, and return how many were
+     * deleted. Like insert_batch, the batch is sorted first and large batches relink
+     * the whole tree instead, with three temporary vectors of up to n node pointers.
+     */
+    template <std::ranges::input_range R>
+    auto erase_batch(R&& range) -> size_t {
+        std::vector<T> batch(std::ranges::begin(range), std::ranges::end(range));
+        std::ranges::sort(batch, Compare {});
+        size_t erased { 0 };
+
+        if (batch.size() * denseBatchRatio >= _size) {
+            // only partition while Compare can still throw; nothing is unlinked or
+            // destroyed until the tree has been relinked from the kept nodes
+            std::vector<Node*> existing = sortedNodes();
+            std::vector<Node*> kept;
+            kept.reserve(_size);
+            std::vector<Node*> removed;
+            removed.reserve(std::min(batch.size(), _size));
+            auto val = batch.begin();
+            for (Node* node : existing) {
+                while (val != batch.end() && Compare {}(*val, node->data)) {
+                    ++val;
+                }
+                if (val != batch.end() && !Compare {}(node->data, *val)) {
+                    removed.push_back(node);
+                    ++val;
+                } else {
+                    kept.push_back(node);
+                }
+            }
+            relinkSorted(kept);
+            for (Node* node : removed) {
+                destroyNode(node);
+            }
+            return removed.size();
+        }
+
+        for (const T& val : batch) {
+            erased += eraseNode(findNode(val));
+        }
+        return erased;
+    }
+
+    auto deleteNode(const T& data) -> bool { return eraseNode(findNode(data)); }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    auto deleteNode(const K& key) -> bool {
+        return eraseNode(findNode(probe(key)));
+    }
+
     [[nodiscard]] auto search(const T& val) -> std::optional<Node*> {
+        Node* node = findNode(val);
+        if (node == nullptr) {
+            return {};
+        }
+        return node;
+    }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    [[nodiscard]] auto search(const K& key) -> std::optional<Node*> {
+        Node* node = findNode(probe(key));
+        if (node == nullptr) {
+            return {};
+        }
+        return node;
+    }
+
+    /*
+     * Look up every key, writing the node found for keys[i] (or nullptr) to out[i].
+     * Up to Group descents are interleaved, and the next node of each one is prefetched
+     * before moving on to the others, so Group cache misses are in flight at once
+     * instead of one. Only pays off once the tree doesn't fit in cache.
+     */
+    template <size_t Group = 32>
+    void search_many(std::span<const T> keys, std::span<Node*> out) {
+        size_t count = std::min(keys.size(), out.size());
+        std::array<Node*, Group> nodes {};
+        std::array<size_t, Group> slots {};
+
+        size_t next { 0 };
+        size_t active { 0 };
+        for (; active < Group && next < count; ++active, ++next) {
+            nodes[active] = _root;
+            slots[active] = next;
+        }
+
+        while (active > 0) {
+            for (size_t i = 0; i < active;) {
+                Node* node = nodes[i];
+                if (node != nullptr) {
+                    const T& key = keys[slots[i]];
+                    bool less = Compare {}(key, node->data);
+                    if (less || Compare {}(node->data, key)) {
+                        node = less ? node->left : node->right;
+                        __builtin_prefetch(node);
+                        nodes[i++] = node;
+                        continue;
+                    }
+                }
+
+                // this descent is done, start the next key in its place
+                out[slots[i]] = node;
+                if (next < count) {
+                    nodes[i] = _root;
+                    slots[i++] = next++;
+                } else {
+                    --active;
+                    nodes[i] = nodes[active];
+                    slots[i] = slots[active];
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] auto begin() const -> Iterator { return Iterator { minNode(_root), this }; }
+
+    [[nodiscard]] auto end() const -> Iterator { return Iterator { nullptr, this }; }
+
+    /*
+     * Iterator to the first element that isn't less than val
+     */
+    [[nodiscard]] auto lower_bound(const T& val) const -> Iterator { return Iterator { lowerBoundNode(val), this }; }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    [[nodiscard]] auto lower_bound(const K& key) const -> Iterator {
+        return Iterator { lowerBoundNode(probe(key)), this };
+    }
+
+    /*
+     * Iterator to the first element that is greater than val
+     */
+    [[nodiscard]] auto upper_bound(const T& val) const -> Iterator { return Iterator { upperBoundNode(val), this }; }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    [[nodiscard]] auto upper_bound(const K& key) const -> Iterator {
+        return Iterator { upperBoundNode(probe(key)), this };
+    }
+
+    [[nodiscard]] auto equal_range(const T& val) const -> std::pair<Iterator, Iterator> {
+        return { lower_bound(val), upper_bound(val) };
+    }
+
+    template <typename K>
+        requires TransparentCompare<Compare>
+    [[nodiscard]] auto equal_range(const K& key) const -> std::pair<Iterator, Iterator> {
+        const auto& lookup = probe(key);
+        return { lower_bound(lookup), upper_bound(lookup) };
+    }
+
+    /*
+     * Call fn on every element in [lo, hi] in sorted order. Costs O(log n + k)
+     * for k visited elements.
+     */
+    template <typename Fn>
+    void for_each_in_range(const T& lo, const T& hi, Fn&& fn) const {
+        for (Node* node = lowerBoundNode(lo); node != nullptr && !Compare {}(hi, node->data); node = nextNode(node)) {
+            fn(std::as_const(node->data));
+        }
+    }
+
+    /*
+     * In-order walk for augmented trees that skips whole subtrees. skip(aug) is called
+     * with a subtree's augmented value before entering it, and fn(data) returns false
+     * to stop the walk. Uses the parent pointers, so it needs no stack or allocation.
+     */
+    template <typename Skip, typename Fn>
+        requires augmented
+    void for_each_pruned(Skip&& skip, Fn&& fn) const {
+        Node* prev = nullptr;
+        Node* node = _root;
+        while (node != nullptr) {
+            Node* from = prev;
+            prev = node;
+
+            if (from == node->parent) {
+                if (skip(std::as_const(node->aug))) {
+                    node = node->parent;
+                    continue;
+                }
+                if (node->left != nullptr) {
+                    node = node->left;
+                    continue;
+                }
+            }
+
+            if (from == node->parent || from == node->left) {
+                if (!fn(std::as_const(node->data))) {
+                    return;
+                }
+                if (node->right != nullptr) {
+                    node = node->right;
+                    continue;
+                }
+            }
+            node = node->parent;
+        }
+    }
+
+    /*
+     * The k-th smallest element (0 indexed). Requires the SubtreeSize augmentation.
+     */
+    [[nodiscard]] auto select(size_t k) -> std::optional<Node*>
+        requires std::is_same_v<Augment, SubtreeSize>
+    {
         Node* curr = _root;
         while (curr != nullptr) {
-            if (Compare {}(val, curr->data)) {
+            size_t leftSize = subtreeSize(curr->left);
+            if (k < leftSize) {
                 curr = curr->left;
-            } else if (Compare {}(curr->data, val)) {
-                curr = curr->right;
-            } else {
+            } else if (k == leftSize) {
                 return curr;
+            } else {
+                k -= leftSize + 1;
+                curr = curr->right;
             }
         }
         return {};
     }
 
-    auto checkInvariant() const -> bool { return std::get<0>(checkInvariantHelper(_root, false)); }
+    /*
+     * Number of elements strictly less than val. Requires the SubtreeSize augmentation.
+     */
+    [[nodiscard]] auto rank(const T& val) const -> size_t
+        requires std::is_same_v<Augment, SubtreeSize>
+    {
+        size_t rank { 0 };
+        Node* curr = _root;
+        while (curr != nullptr) {
+            if (Compare {}(curr->data, val)) {
+                rank += subtreeSize(curr->left) + 1;
+                curr = curr->right;
+            } else {
+                curr = curr->left;
+            }
+        }
+        return rank;
+    }
+
+    auto checkInvariant() const -> bool {
+        if constexpr (augmented) {
+            if (!checkAugmentHelper(_root)) {
+                return false;
+            }
+        }
+        if (_root != nullptr && (_root->parent != nullptr || _root->color != Color::Black)) {
+            return false;
+        }
+        return checkInvariantHelper(_root).has_value() && checkOrder();
+    }
 
     void print() { printTree(_root); }
 
     [[nodiscard]] auto size() const noexcept -> size_t { return _size; }
+
+    [[nodiscard]] auto pool() const noexcept -> const NodePool<Node>& { return _pool; }
 };
+
+template <typename T, typename Compare = std::less<T>>
+using OrderStatisticTree = RBTree<T, Compare, SlabPool, SubtreeSize>;
+
+/*
+ * Key/value map mode. Elements are std::pair<const K, V> ordered by key, and can be
+ * looked up by key alone.
+ */
+template <typename K, typename V, typename Compare = std::less<K>>
+using RBMap = RBTree<std::pair<const K, V>, MapCompare<K, V, Compare>>;
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "red_black.hpp"
+
+/*
+ * Ordered multiset that can be used from many threads at once. The key space is cut
+ * into ranges by a sorted list of splitters, and every range is its own RBTree behind
+ * its own reader/writer lock: lookups only take a shared lock on one shard, and writes
+ * only block the shard they touch.
+ *
+ * Nodes can be deleted as soon as a lock is released, so lookups return copies of the
+ * data instead of Node pointers.
+ */
+template <typename T, typename Compare = std::less<T>>
+class ShardedRBTree {
+    // each shard on its own cache lines, so shards don't slow each other down
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        RBTree<T, Compare> tree;
+    };
+
+    std::vector<T> _splitters;
+    std::unique_ptr<Shard[]> _shards;
+
+    // shard i holds the keys in [splitters[i - 1], splitters[i])
+    [[nodiscard]] auto shardFor(const T& key) const -> Shard& {
+        auto it = std::ranges::upper_bound(_splitters, key, Compare {});
+        return _shards[it - _splitters.begin()];
+    }
+
+public:
+    /*
+     * One shard per range between consecutive splitters, which must be sorted. With no
+     * splitters everything goes through a single lock.
+     */
+    explicit ShardedRBTree(std::vector<T> splitters = {})
+        : _splitters { std::move(splitters) }
+        , _shards { std::make_unique<Shard[]>(_splitters.size() + 1) } {}
+
+    /*
+     * Split the key space into shards ranges that each hold about the same number of
+     * the sample's keys
+     */
+    template <std::ranges::input_range R>
+    [[nodiscard]] static auto from_sample(R&& sample, size_t shards) -> ShardedRBTree {
+        std::vector<T> sorted(std::ranges::begin(sample), std::ranges::end(sample));
+        std::ranges::sort(sorted, Compare {});
+
+        std::vector<T> splitters;
+        for (size_t i = 1; i < shards && !sorted.empty(); ++i) {
+            const T& splitter = sorted[i * sorted.size() / shards];
+            if (splitters.empty() || Compare {}(splitters.back(), splitter)) {
+                splitters.push_back(splitter);
+            }
+        }
+        return ShardedRBTree { std::move(splitters) };
+    }
+
+    void insert(T data) {
+        Shard& shard = shardFor(data);
+        std::unique_lock lock { shard.mutex };
+        shard.tree.insert(std::move(data));
+    }
+
+    auto deleteNode(const T& data) -> bool {
+        Shard& shard = shardFor(data);
+        std::unique_lock lock { shard.mutex };
+        return shard.tree.deleteNode(data);
+    }
+
+    [[nodiscard]] auto search(const T& val) const -> std::optional<T> {
+        Shard& shard = shardFor(val);
+        std::shared_lock lock { shard.mutex };
+        auto node = shard.tree.search(val);
+        if (!node.has_value()) {
+            return {};
+        }
+        return node.value()->data;
+    }
+
+    [[nodiscard]] auto contains(const T& val) const -> bool {
+        Shard& shard = shardFor(val);
+        std::shared_lock lock { shard.mutex };
+        return shard.tree.search(val).has_value();
+    }
+
+    /*
+     * Call fn on every element in [lo, hi] in order. Shards are locked one at a time,
+     * so the elements of each shard are consistent, but changes to later shards made
+     * during the walk can show up.
+     */
+    template <typename Fn>
+    void for_each_in_range(const T& lo, const T& hi, Fn&& fn) const {
+        size_t first = std::ranges::upper_bound(_splitters, lo, Compare {}) - _splitters.begin();
+        size_t last = std::ranges::upper_bound(_splitters, hi, Compare {}) - _splitters.begin();
+        for (size_t i = first; i <= last; ++i) {
+            std::shared_lock lock { _shards[i].mutex };
+            _shards[i].tree.for_each_in_range(lo, hi, fn);
+        }
+    }
+
+    [[nodiscard]] auto size() const -> size_t {
+        size_t size { 0 };
+        for (size_t i = 0; i <= _splitters.size(); ++i) {
+            std::shared_lock lock { _shards[i].mutex };
+            size += _shards[i].tree.size();
+        }
+        return size;
+    }
+
+    [[nodiscard]] auto shards() const noexcept -> size_t { return _splitters.size() + 1; }
+
+    /*
+     * Every shard is a valid tree and only holds keys from its own range. Not safe to
+     * call while other threads are writing.
+     */
+    auto checkInvariant() const -> bool {
+        for (size_t i = 0; i <= _splitters.size(); ++i) {
+            const auto& tree = _shards[i].tree;
+            if (!tree.checkInvariant()) {
+                return false;
+            }
+            if (tree.size() == 0) {
+                continue;
+            }
+            if ((i > 0 && Compare {}(*tree.begin(), _splitters[i - 1])) ||
+                (i < _splitters.size() && !Compare {}(*std::prev(tree.end()), _splitters[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "red_black.hpp"
+
+/*
+ * Quantiles over the last capacity samples. The window is kept sorted in an order
+ * statistic tree, and a ring buffer remembers arrival order so the oldest sample can be
+ * dropped. push and quantile are O(log capacity), and once the window is full the
+ * tree's slab pool hands the dropped sample's node straight back, so nothing allocates.
+ */
+template <typename T, typename Compare = std::less<T>>
+class SlidingQuantile {
+    OrderStatisticTree<T, Compare> _window;
+    std::vector<T> _arrivals;
+    size_t _capacity;
+    // slot of the oldest sample once the ring is full
+    size_t _head { 0 };
+
+public:
+    explicit SlidingQuantile(size_t capacity)
+        : _capacity { std::max<size_t>(capacity, 1) } {
+        _arrivals.reserve(_capacity);
+    }
+
+    void push(const T& sample) {
+        if (_arrivals.size() < _capacity) {
+            _arrivals.push_back(sample);
+        } else {
+            _window.deleteNode(_arrivals[_head]);
+            _arrivals[_head] = sample;
+            _head = (_head + 1) % _capacity;
+        }
+        _window.insert(sample);
+    }
+
+    /*
+     * Nearest-rank quantile: the smallest sample with at least q of the window at or
+     * below it, for q in [0, 1]
+     */
+    [[nodiscard]] auto quantile(double q) -> std::optional<T> {
+        if (_window.size() == 0) {
+            return {};
+        }
+        auto rank = static_cast<size_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(_window.size())));
+        return _window.select(rank == 0 ? 0 : rank - 1).value()->data;
+    }
+
+    [[nodiscard]] auto median() -> std::optional<T> { return quantile(0.5); }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _window.size(); }
+
+    [[nodiscard]] auto capacity() const noexcept -> size_t { return _capacity; }
+};
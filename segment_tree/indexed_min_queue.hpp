@@ -0,0 +1,150 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+template <typename P>
+struct IndexedEntry {
+    P priority {};
+    size_t index { 0 };
+    bool present { false };
+};
+
+/*
+ * Argmin over entries. Missing entries act as the identity, and ties go to the lower
+ * index so the queue pops in a deterministic order.
+ */
+template <typename P, typename Compare>
+struct IndexedArgMin {
+    auto operator()(const IndexedEntry<P>& lhs, const IndexedEntry<P>& rhs) const -> IndexedEntry<P> {
+        if (!rhs.present) {
+            return lhs;
+        }
+        if (!lhs.present) {
+            return rhs;
+        }
+        if (Compare {}(rhs.priority, lhs.priority)) {
+            return rhs;
+        }
+        if (Compare {}(lhs.priority, rhs.priority)) {
+            return lhs;
+        }
+        return lhs.index <= rhs.index ? lhs : rhs;
+    }
+};
+
+/*
+ * Min priority queue over a fixed set of ids [0, n). Each id holds at most one priority,
+ * so priorities can be changed in place instead of pushing duplicates.
+ *
+ * The entries are an iterative segment tree in one vector of 2n slots: leaf i is at
+ * n + i and node j combines 2j and 2j + 1, so an update walks straight up from its leaf
+ * without recursion and node 1 always holds the current minimum. The argmin Op is
+ * commutative (ties go by index), so this layout works for any n, not just powers of two.
+ */
+template <typename P, typename Compare = std::less<P>>
+class IndexedMinQueue {
+    using Entry = IndexedEntry<P>;
+    using ArgMin = IndexedArgMin<P, Compare>;
+
+    size_t _ids;
+    size_t _count { 0 };
+    std::vector<Entry> _tree;
+
+    // recombine every node above leaf id, once the leaf has changed
+    auto siftUp(size_t id) -> void {
+        for (size_t node = (_ids + id) / 2; node > 0; node /= 2) {
+            _tree[node] = ArgMin {}(_tree[2 * node], _tree[2 * node + 1]);
+        }
+    }
+
+    auto build() -> void {
+        for (size_t node = _ids; node-- > 1;) {
+            _tree[node] = ArgMin {}(_tree[2 * node], _tree[2 * node + 1]);
+        }
+    }
+
+public:
+    /*
+     * Create an empty queue that can hold the ids [0, n)
+     */
+    explicit IndexedMinQueue(size_t n)
+        : _ids { n }
+        , _tree(2 * n) {
+        for (size_t i = 0; i < n; ++i) {
+            _tree[n + i].index = i;
+        }
+        build();
+    }
+
+    /*
+     * Create a queue where id i holds priorities[i]
+     */
+    explicit IndexedMinQueue(const std::vector<P>& priorities)
+        : _ids { priorities.size() }
+        , _count { priorities.size() }
+        , _tree(2 * priorities.size()) {
+        for (size_t i = 0; i < _ids; ++i) {
+            _tree[_ids + i] = { priorities[i], i, true };
+        }
+        build();
+    }
+
+    /*
+     * Set the priority of id, inserting it if it isn't in the queue
+     */
+    auto change_priority(size_t id, const P& priority) -> void {
+        if (id >= _ids) {
+            return;
+        }
+        Entry& leaf = _tree[_ids + id];
+        if (!leaf.present) {
+            ++_count;
+        }
+        leaf = { priority, id, true };
+        siftUp(id);
+    }
+
+    auto push(size_t id, const P& priority) -> void { change_priority(id, priority); }
+
+    /*
+     * Remove id from the queue. Returns false if it wasn't queued.
+     */
+    auto erase(size_t id) -> bool {
+        if (!contains(id)) {
+            return false;
+        }
+        --_count;
+        _tree[_ids + id] = { P {}, id, false };
+        siftUp(id);
+        return true;
+    }
+
+    /*
+     * The (id, priority) pair with the smallest priority
+     */
+    [[nodiscard]] auto peek_min() const -> std::optional<std::pair<size_t, P>> {
+        if (_count == 0) {
+            return {};
+        }
+        // with a single id its leaf is node 1, so this is the root either way
+        const Entry& root = _tree[1];
+        return std::pair { root.index, root.priority };
+    }
+
+    auto pop_min() -> std::optional<std::pair<size_t, P>> {
+        auto min = peek_min();
+        if (min.has_value()) {
+            erase(min->first);
+        }
+        return min;
+    }
+
+    [[nodiscard]] auto contains(size_t id) const -> bool { return id < _ids && _tree[_ids + id].present; }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _count; }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return _count == 0; }
+};
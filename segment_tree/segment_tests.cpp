@@ -1,10 +1,14 @@
 #include <algorithm>
 #include <cstddef>
+#include <deque>
 #include <random>
+#include <set>
 
 #include "gtest/gtest.h"
+#include "indexed_min_queue.hpp"
 #include "ksegment.hpp"
 #include "segment.hpp"
+#include "sliding_segment.hpp"
 
 TEST(SegmentTreeTest, SegmentTreeSingle) {
     std::vector<int> nums = { 1 };
@@ -206,3 +210,177 @@ TEST(SegmentTreeTest, StringSegmentTree) {
     ASSERT_EQ(st.query(0, 4), "abcdq");
     ASSERT_EQ(st.query(0, 3), "abcd");
 }
+
+
+TEST(SlidingSegmentTreeTest, SlidingEmptyAndFill) {
+    SlidingSegmentTree<int> st(3);
+    ASSERT_EQ(st.window_query(), std::nullopt);
+    ASSERT_EQ(st.query(0, 0), std::nullopt);
+
+    st.push(1);
+    st.push(2);
+    ASSERT_EQ(st.size(), 2);
+    ASSERT_EQ(st.window_query(), 3);
+    ASSERT_EQ(st.query(0, 0), 2);
+    ASSERT_EQ(st.query(1, 1), 1);
+    ASSERT_EQ(st.query(0, 2), std::nullopt);
+
+    st.push(3);
+    st.push(4);
+    ASSERT_EQ(st.size(), 3);
+    ASSERT_EQ(st.window_query(), 9);
+    ASSERT_EQ(st.query(0, 0), 4);
+    ASSERT_EQ(st.query(2, 2), 2);
+    ASSERT_EQ(st.query(1, 2), 5);
+    ASSERT_EQ(st.query(2, 1), std::nullopt);
+}
+
+TEST(SlidingSegmentTreeTest, SlidingZeroCapacity) {
+    SlidingSegmentTree<int> st(0);
+    ASSERT_EQ(st.capacity(), 1);
+    ASSERT_EQ(st.window_query(), std::nullopt);
+
+    st.push(5);
+    st.push(7);
+    ASSERT_EQ(st.size(), 1);
+    ASSERT_EQ(st.window_query(), 7);
+}
+
+TEST(SlidingSegmentTreeTest, SlidingStringOrder) {
+    auto merge = [](auto& a, auto& b) { return a + b; };
+    auto base = [](char data) { return std::string(1, data); };
+
+    SlidingSegmentTree<char, std::string, decltype(merge), decltype(base)> st(4);
+    for (char c : std::string("abcdefg")) {
+        st.push(c);
+    }
+
+    // window wraps around the buffer, but is still combined oldest to newest
+    ASSERT_EQ(st.window_query(), "defg");
+    ASSERT_EQ(st.query(0, 1), "fg");
+    ASSERT_EQ(st.query(1, 3), "def");
+    ASSERT_EQ(st.query(2, 2), "e");
+}
+
+TEST(SlidingSegmentTreeTest, SlidingMaxRandomLarge) {
+    std::mt19937 mt {};
+    mt.seed(871);
+
+    constexpr size_t window = 37;
+    std::uniform_int_distribution<int> valueDist { -1000, 1000 };
+    std::uniform_int_distribution<size_t> ageDist { 0, window - 1 };
+
+    SlidingSegmentTree<int, int, decltype([](int left, int right) { return std::max(left, right); })> st(window);
+    std::deque<int> recent;
+    for (int i = 0; i < 100000; ++i) {
+        int value = valueDist(mt);
+        st.push(value);
+        recent.push_front(value);
+        if (recent.size() > window) {
+            recent.pop_back();
+        }
+        ASSERT_EQ(st.size(), recent.size());
+
+        auto [lower, upper] = std::minmax({ ageDist(mt), ageDist(mt) });
+        auto query = st.query(lower, upper);
+        if (upper >= recent.size()) {
+            ASSERT_EQ(query, std::nullopt);
+            continue;
+        }
+        ASSERT_EQ(query, *std::ranges::max_element(recent.begin() + lower, recent.begin() + upper + 1));
+        ASSERT_EQ(st.window_query(), *std::ranges::max_element(recent));
+    }
+}
+
+TEST(IndexedMinQueueTest, IndexedSimple) {
+    IndexedMinQueue<int> queue(std::vector<int> { 5, 3, 8, 3 });
+    ASSERT_EQ(queue.size(), 4);
+    ASSERT_EQ(queue.peek_min(), std::pair(size_t { 1 }, 3));
+
+    queue.change_priority(2, 1);
+    ASSERT_EQ(queue.peek_min(), std::pair(size_t { 2 }, 1));
+
+    ASSERT_EQ(queue.pop_min(), std::pair(size_t { 2 }, 1));
+    ASSERT_EQ(queue.pop_min(), std::pair(size_t { 1 }, 3));
+    ASSERT_EQ(queue.pop_min(), std::pair(size_t { 3 }, 3));
+    ASSERT_FALSE(queue.contains(3));
+
+    ASSERT_TRUE(queue.erase(0));
+    ASSERT_FALSE(queue.erase(0));
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.pop_min(), std::nullopt);
+
+    queue.push(3, 10);
+    ASSERT_EQ(queue.peek_min(), std::pair(size_t { 3 }, 10));
+}
+
+TEST(IndexedMinQueueTest, IndexedEdgeSizes) {
+    IndexedMinQueue<int> none(0);
+    ASSERT_EQ(none.peek_min(), std::nullopt);
+    none.push(0, 1);
+    ASSERT_TRUE(none.empty());
+    ASSERT_FALSE(none.erase(0));
+
+    IndexedMinQueue<int> one(1);
+    one.push(0, 4);
+    const auto& view = one;
+    ASSERT_EQ(view.peek_min(), std::pair(size_t { 0 }, 4));
+    ASSERT_EQ(one.pop_min(), std::pair(size_t { 0 }, 4));
+    ASSERT_EQ(view.peek_min(), std::nullopt);
+}
+
+TEST(IndexedMinQueueTest, IndexedRandomLarge) {
+    std::mt19937 mt {};
+    mt.seed(1093);
+
+    constexpr size_t ids = 200;
+    std::uniform_int_distribution<size_t> idDist { 0, ids - 1 };
+    std::uniform_int_distribution<int> priorityDist { -500, 500 };
+    std::uniform_int_distribution<int> actionDist { 0, 2 };
+
+    IndexedMinQueue<int> queue(ids);
+    std::vector<std::optional<int>> priorities(ids);
+    std::set<std::pair<int, size_t>> reference;
+
+    for (int i = 0; i < 100000; ++i) {
+        size_t id = idDist(mt);
+        switch (actionDist(mt)) {
+        case 0: {
+            int priority = priorityDist(mt);
+            if (priorities[id].has_value()) {
+                reference.erase({ *priorities[id], id });
+            }
+            priorities[id] = priority;
+            reference.insert({ priority, id });
+            queue.change_priority(id, priority);
+            break;
+        }
+        case 1: {
+            bool queued = priorities[id].has_value();
+            if (queued) {
+                reference.erase({ *priorities[id], id });
+                priorities[id].reset();
+            }
+            ASSERT_EQ(queue.erase(id), queued);
+            break;
+        }
+        default: {
+            auto popped = queue.pop_min();
+            if (reference.empty()) {
+                ASSERT_EQ(popped, std::nullopt);
+                break;
+            }
+            auto [priority, minId] = *reference.begin();
+            reference.erase(reference.begin());
+            priorities[minId].reset();
+            ASSERT_EQ(popped, std::pair(minId, priority));
+            break;
+        }
+        }
+
+        ASSERT_EQ(queue.size(), reference.size());
+        if (!reference.empty()) {
+            ASSERT_EQ(queue.peek_min(), std::pair(reference.begin()->second, reference.begin()->first));
+        }
+    }
+}
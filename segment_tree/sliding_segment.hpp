@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+#include "segment.hpp"
+
+/*
+ * Segment tree over the last `capacity` pushed values. The leaves are used as a
+ * circular buffer, so pushing a new value overwrites the oldest leaf with a single
+ * O(log W) update instead of rebuilding the tree. Since nothing is ever "removed"
+ * from the aggregate, Op doesn't need an inverse (max, min, gcd, etc. all work).
+ *
+ * Queries are indexed by age: age 0 is the most recently pushed value. Results are
+ * always combined from oldest to newest, so non-commutative operations see the values
+ * in arrival order.
+ */
+template <typename T, typename NodeVal = T,
+          typename Op = decltype([](const NodeVal& a, const NodeVal& b) { return a + b; }),
+          typename Base = decltype([](const T& data) -> NodeVal { return static_cast<NodeVal>(data); })>
+class SlidingSegmentTree {
+    SegmentTree<T, NodeVal, Op, Base> _tree;
+    size_t _capacity;
+    size_t _head { 0 };
+    size_t _size { 0 };
+
+    // physical leaf index of the value with the given age
+    [[nodiscard]] auto slot(size_t age) const noexcept -> size_t { return (_head + _capacity - 1 - age) % _capacity; }
+
+public:
+    /*
+     * A window always holds at least one value, so a capacity of 0 is treated as 1
+     */
+    explicit SlidingSegmentTree(size_t capacity)
+        : _tree { std::vector<T>(std::max<size_t>(capacity, 1)) }
+        , _capacity { std::max<size_t>(capacity, 1) } {}
+
+    /*
+     * Push a new value into the window, evicting the oldest value if the window is full
+     */
+    auto push(const T& value) -> void {
+        _tree.update(_head, value);
+        _head = (_head + 1) % _capacity;
+        if (_size < _capacity) {
+            ++_size;
+        }
+    }
+
+    /*
+     * Aggregate of the values with ages in [ageLo, ageHi], where age 0 is the newest
+     * value. Returns nothing if the range is invalid or not yet filled.
+     */
+    [[nodiscard]] auto query(size_t ageLo, size_t ageHi) const -> std::optional<NodeVal> {
+        if (ageLo > ageHi || ageHi >= _size) {
+            return {};
+        }
+
+        size_t oldest = slot(ageHi);
+        size_t newest = slot(ageLo);
+        if (oldest <= newest) {
+            return _tree.query(oldest, newest);
+        }
+        // the range wraps around the end of the buffer
+        NodeVal left = _tree.query(oldest, _capacity - 1);
+        NodeVal right = _tree.query(0, newest);
+        return Op {}(left, right);
+    }
+
+    /*
+     * Aggregate of every value currently in the window
+     */
+    [[nodiscard]] auto window_query() const -> std::optional<NodeVal> {
+        if (_size == 0) {
+            return {};
+        }
+        return query(0, _size - 1);
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _size; }
+
+    [[nodiscard]] auto capacity() const noexcept -> size_t { return _capacity; }
+};